@@ -26,13 +26,23 @@
 #include <thread>
 #include <atomic>
 #include <csignal>
+#include <list>
+#include <vector>
+#include <chrono>
+
+#include <pthread.h>
+#include <sched.h>
 
 #include <boost/asio.hpp>
 #include <boost/program_options.hpp>
 
 #include "modules/ModuleManager.hpp"
 #include "modules/socket/RawSocket.hpp"
+#include "modules/socket/TunTapSocket.hpp"
+#include "modules/socket/XdpSocket.hpp"
+#include "utils/IoUring.hpp"
 #include "utils/Mqtt.hpp"
+#include "utils/PacketPool.hpp"
 
 using namespace std;
 
@@ -45,11 +55,45 @@ void signalHandler(int signum) {
 	io_service.stop();
 }
 
+void pinThread(int cpu) {
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(cpu, &cpu_set);
+	if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+		cerr << "Cannot pin thread to CPU " << cpu << "!" << endl;
+	}
+}
+
+// Spin on the I/O service instead of sleeping in epoll, so that handlers and
+// timers run without wakeup latency. After the given idle time without any
+// handler, it blocks in epoll until the next handler is ready.
+void runBusyPoll(boost::asio::io_service &io_service, chrono::microseconds idle_timeout) {
+	auto idle_since = chrono::steady_clock::now();
+	while(!io_service.stopped()) {
+		if(io_service.poll() > 0) {
+			idle_since = chrono::steady_clock::now();
+			continue;
+		}
+
+		if(chrono::steady_clock::now() - idle_since >= idle_timeout) {
+			io_service.run_one();
+			idle_since = chrono::steady_clock::now();
+		}
+	}
+}
+
 namespace po = boost::program_options;
 
 int main(int argc, const char *argv[]) {
 	string interface_source;
 	string interface_sink;
+	string socket_backend;
+	unsigned int workers;
+	unsigned int threads;
+	string event_loop;
+	double busy_poll;
+	double busy_poll_idle;
+	int busy_poll_cpu;
 	string mqtt_broker;
 	uint16_t mqtt_port;
 	string graph_file;
@@ -60,6 +104,16 @@ int main(int argc, const char *argv[]) {
 		("help", "Display this help message and exit")
 		("interface-source", po::value<string>(&interface_source), "Name of network interface connected to source")
 		("interface-sink", po::value<string>(&interface_sink), "Name of network interface connected to sink")
+		("no-interfaces", "Run without network interfaces, e.g. with traffic generator and sink modules")
+		("socket-backend", po::value<string>(&socket_backend)->default_value("raw"), "Socket backend used for the interfaces (raw, xdp, tap, tun)")
+		("workers", po::value<unsigned int>(&workers)->default_value(1), "Number of threads the sockets spread flows over (raw backend only)")
+		("threads", po::value<unsigned int>(&threads)->default_value(1), "Number of threads the modules of the graph are assigned to by their thread attribute")
+		("split-directions", "Run the sink socket and the sink to source halves of directional modules on an extra thread (other modules of that direction need their thread attribute set to it)")
+		("event-loop", po::value<string>(&event_loop)->default_value("epoll"), "Event loop used for socket I/O (epoll, io_uring)")
+		("busy-poll", po::value<double>(&busy_poll)->default_value(0), "Spin on pinned CPUs and busy poll sockets for the given time in µs (0 to disable)")
+		("busy-poll-idle", po::value<double>(&busy_poll_idle)->default_value(100), "Idle time in ms after which busy polling falls back to epoll until the next event")
+		("busy-poll-cpu", po::value<int>(&busy_poll_cpu)->default_value(-1), "First CPU the busy polling threads are pinned to (-1 for the last CPUs)")
+		("hugepages", "Back the packet buffer pool with huge pages")
 		("mqtt-host", po::value<string>(&mqtt_broker)->default_value("localhost"), "MQTT broker host")
 		("mqtt-port", po::value<uint16_t>(&mqtt_port)->default_value(1883), "MQTT broker port")
 		("graph-file", po::value<string>(&graph_file)->default_value("autosave"), "Graph file that will be loaded")
@@ -78,26 +132,132 @@ int main(int argc, const char *argv[]) {
 		return 0;
 	}
 
-	if(!vm.count("interface-source") || !vm.count("interface-sink")) {
+	PacketPool::setHugepages(vm.count("hugepages"));
+
+	const bool no_interfaces = vm.count("no-interfaces");
+	const bool split_directions = vm.count("split-directions");
+	if(!no_interfaces && (!vm.count("interface-source") || !vm.count("interface-sink"))) {
 		cout << "No interfaces given!" << endl;
 		return 1;
 	}
 
+	if(socket_backend != "raw" && socket_backend != "xdp" && socket_backend != "tap" && socket_backend != "tun") {
+		cout << "Unknown socket backend " << socket_backend << "!" << endl;
+		return 1;
+	}
+
+	if(workers == 0 || (workers > 1 && socket_backend != "raw")) {
+		cout << "Multiple workers are only supported with the raw socket backend!" << endl;
+		return 1;
+	}
+
+	if(workers > 1 && no_interfaces) {
+		cout << "Multiple workers require interfaces!" << endl;
+		return 1;
+	}
+
+	if(threads == 0) {
+		cout << "At least one thread is required!" << endl;
+		return 1;
+	}
+
+	if(event_loop != "epoll" && event_loop != "io_uring") {
+		cout << "Unknown event loop " << event_loop << "!" << endl;
+		return 1;
+	}
+
 	cout << "Starting FlowEmu..." << endl;
 
+	// Worker and graph thread I/O services have to outlive the modules
+	// running on them
+	list<boost::asio::io_service> worker_io_services;
+
 	// MQTT
 	Mqtt mqtt(mqtt_broker, mqtt_port, "FlowEmu");
 
 	// Module manager
 	ModuleManager module_manager(io_service, mqtt);
 
+	// Additional graph threads run the modules assigned to them, paths
+	// between modules on different threads are linked by lock-free rings
+	for(unsigned int i = 1; i < threads; ++i) {
+		auto &thread_io_service = worker_io_services.emplace_back();
+		if(event_loop == "io_uring") {
+			boost::asio::use_service<IoUring>(thread_io_service);
+		}
+		module_manager.addThread(thread_io_service);
+	}
+
+	// The extra thread runs the sink socket and the right-to-left halves of
+	// directional modules (delay, loss). Other modules stay on the thread
+	// given by their thread attribute, so a queue or rate of the sink to
+	// source direction only moves if it is set to this thread. The sink
+	// socket also transmits the source to sink direction from here, while
+	// the source socket transmits the sink to source direction from thread
+	// 0, so neither direction runs on a thread of its own.
+	unsigned int rl_thread = 0;
+	boost::asio::io_service *rl_io_service = &io_service;
+	if(split_directions) {
+		rl_thread = threads;
+		rl_io_service = &worker_io_services.emplace_back();
+		if(event_loop == "io_uring") {
+			boost::asio::use_service<IoUring>(*rl_io_service);
+		}
+		module_manager.addThread(*rl_io_service);
+		module_manager.setDefaultRlThread(rl_thread);
+	}
+
+	// Sockets pick up the io_uring of their I/O service
+	if(event_loop == "io_uring") {
+		boost::asio::use_service<IoUring>(io_service);
+	}
+
 	// Sockets
-	auto socket_source = make_shared<RawSocket>(io_service, interface_source, Module::PortInfo::Side::right);
-	socket_source->setRemovable(false);
-	module_manager.addModule("socket_source", socket_source);
-	auto socket_sink = make_shared<RawSocket>(io_service, interface_sink, Module::PortInfo::Side::left);
-	socket_sink->setRemovable(false);
-	module_manager.addModule("socket_sink", socket_sink);
+	auto createSocket = [&](boost::asio::io_service &io_service, const string &ifname, Module::PortInfo::Side ports_side) -> shared_ptr<Module> {
+		if(socket_backend == "xdp") {
+			return make_shared<XdpSocket>(io_service, ifname, ports_side);
+		} else if(socket_backend == "tap") {
+			return make_shared<TunTapSocket>(io_service, ifname, ports_side, TunTapSocket::Mode::tap);
+		} else if(socket_backend == "tun") {
+			return make_shared<TunTapSocket>(io_service, ifname, ports_side, TunTapSocket::Mode::tun);
+		}
+		return make_shared<RawSocket>(io_service, ifname, ports_side, workers > 1);
+	};
+	shared_ptr<Module> socket_source;
+	shared_ptr<Module> socket_sink;
+	if(!no_interfaces) {
+		socket_source = createSocket(io_service, interface_source, Module::PortInfo::Side::right);
+		socket_source->setRemovable(false);
+		module_manager.addModule("socket_source", socket_source);
+		socket_sink = createSocket(*rl_io_service, interface_sink, Module::PortInfo::Side::left);
+		socket_sink->setRemovable(false);
+		socket_sink->setThread(rl_thread);
+		socket_sink->setRlThread(rl_thread);
+		module_manager.addModule("socket_sink", socket_sink);
+	}
+
+	// Additional workers receive their share of the flows on their own
+	// sockets and run the replicable part of the graph
+	vector<shared_ptr<Module>> replica_sockets;
+	for(unsigned int i = 1; i < workers; ++i) {
+		auto &worker_io_service = worker_io_services.emplace_back();
+		if(event_loop == "io_uring") {
+			boost::asio::use_service<IoUring>(worker_io_service);
+		}
+		auto replica = make_shared<GraphReplica>(worker_io_service, module_manager.getThreadIoServices(), i);
+
+		auto replica_socket_source = createSocket(worker_io_service, interface_source, Module::PortInfo::Side::right);
+		replica_socket_source->setRemovable(false);
+		replica->addModule("socket_source", replica_socket_source);
+		auto replica_socket_sink = createSocket(worker_io_service, interface_sink, Module::PortInfo::Side::left);
+		replica_socket_sink->setRemovable(false);
+		replica->addModule("socket_sink", replica_socket_sink);
+
+		replica_sockets.push_back(replica_socket_source);
+		replica_sockets.push_back(replica_socket_sink);
+
+		module_manager.addReplica(replica);
+	}
 
 	// Load graph
 	if(vm.count("graph")) {
@@ -112,6 +272,22 @@ int main(int argc, const char *argv[]) {
 		module_manager.loadFromFile("config/graphs/" + graph_file + ".json");
 	}
 	
+	// Busy polling of the sockets, parameters from the command line take precedence
+	if(busy_poll > 0 && !no_interfaces) {
+		vector<shared_ptr<Module>> sockets = {socket_source, socket_sink};
+		sockets.insert(sockets.end(), replica_sockets.begin(), replica_sockets.end());
+		for(const auto& socket : sockets) {
+			// TUN/TAP sockets cannot be busy polled
+			if(socket->getParameters().count("busy_poll") == 0) {
+				continue;
+			}
+
+			if(const auto parameter_busy_poll = dynamic_cast<ParameterDouble*>(socket->getParameter("busy_poll").parameter)) {
+				parameter_busy_poll->set(busy_poll);
+			}
+		}
+	}
+
 	// Get module parameters from command line
 	for(const string& option : po::collect_unrecognized(parsed.options, po::collect_unrecognized_mode::exclude_positional)) {
 		regex r("--([\\w-]+)\\.([\\w-]+)=(.*)");
@@ -157,14 +333,50 @@ int main(int argc, const char *argv[]) {
 	signal(SIGTERM, signalHandler);
 
 	cout << "Successfully started FlowEmu!" << endl;
-	/* while(running) {
-		io_service.poll();
-	} */
-	io_service.run();
+	// Every thread running an I/O service gets its own CPU
+	const int cpus = max(thread::hardware_concurrency(), 1u);
+	if(busy_poll_cpu < 0) {
+		busy_poll_cpu = max(cpus - (int) (worker_io_services.size() + 1), 0);
+	}
+	const chrono::microseconds busy_poll_idle_timeout((int64_t) (busy_poll_idle * 1000.0));
+
+	list<thread> worker_threads;
+	int worker_cpu = busy_poll_cpu;
+	for(auto &worker_io_service : worker_io_services) {
+		worker_cpu = (worker_cpu + 1) % cpus;
+		worker_threads.emplace_back([&, worker_cpu](){
+			auto work_guard = boost::asio::make_work_guard(worker_io_service);
+			if(busy_poll > 0) {
+				pinThread(worker_cpu);
+				runBusyPoll(worker_io_service, busy_poll_idle_timeout);
+			} else {
+				worker_io_service.run();
+			}
+		});
+	}
+
+	// Keep running even if no module has pending work, e.g. without interfaces
+	auto work_guard = boost::asio::make_work_guard(io_service);
+
+	if(busy_poll > 0) {
+		pinThread(busy_poll_cpu % cpus);
+		runBusyPoll(io_service, busy_poll_idle_timeout);
+	} else {
+		io_service.run();
+	}
 
 	// Clean up
 	cout << "Stopping FlowEmu..." << endl;
 
+	// Stop workers and graph threads
+	for(auto &worker_io_service : worker_io_services) {
+		worker_io_service.stop();
+	}
+	for(auto &worker_thread : worker_threads) {
+		worker_thread.join();
+	}
+	module_manager.clearReplicas();
+
 	// Save to autosave file
 	module_manager.saveToFile("config/graphs/autosave.json");
 
@@ -0,0 +1,162 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "GraphReplica.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+#include "ModuleManager.hpp"
+
+using namespace std;
+
+GraphReplica::GraphReplica(boost::asio::io_service &io_service, const vector<boost::asio::io_service*> &primary_io_services, unsigned int replica) : io_service(io_service), primary_io_services(primary_io_services), replica(replica) {
+}
+
+void GraphReplica::addModule(const string &id, shared_ptr<Module> module) {
+	modules[id] = module;
+}
+
+void GraphReplica::update(const Json::Value &json_root, const map<string, shared_ptr<Module>> &primary_modules) {
+	// Modules of the replica must only be touched by the worker thread
+	boost::asio::post(io_service, [this, json_root, primary_modules]() {
+		handleUpdate(json_root, primary_modules);
+	});
+}
+
+void GraphReplica::updateModule(const string &id, const Json::Value &json_root) {
+	boost::asio::post(io_service, [this, id, json_root]() {
+		if(modules.find(id) != modules.end()) {
+			modules.at(id)->deserialize(json_root);
+		}
+	});
+}
+
+void GraphReplica::handleUpdate(const Json::Value &json_root, const map<string, shared_ptr<Module>> &primary_modules) {
+	removePaths();
+
+	// Modules that are given to the replica from outside (e.g. sockets) are
+	// not removable and stay in place
+	for(auto it = modules.begin(); it != modules.end(); /*++it*/) {
+		const auto primary_module = primary_modules.find(it->first);
+		if(it->second->getRemovable() && (primary_module == primary_modules.end() || !primary_module->second->getReplicable())) {
+			it = modules.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	const Json::Value &json_modules = json_root["modules"];
+	for(const auto& entry : primary_modules) {
+		if(!json_modules.isMember(entry.first)) {
+			continue;
+		}
+
+		if(modules.find(entry.first) == modules.end()) {
+			if(!entry.second->getReplicable()) {
+				continue;
+			}
+
+			try {
+				modules[entry.first] = ModuleManager::createModule(entry.second->getType(), io_service);
+			} catch(const out_of_range &e) {
+				continue;
+			}
+			modules.at(entry.first)->setReplica(replica);
+		}
+
+		modules.at(entry.first)->deserialize(json_modules[entry.first]);
+	}
+
+	for(const auto& json_path : json_root["paths"]) {
+		if(!(json_path.isMember("from") && json_path.isMember("to"))) {
+			continue;
+		}
+
+		Path path;
+		path.deserialize(json_path);
+
+		const bool from_replicated = (modules.find(path.from_node_id) != modules.end());
+		const bool to_replicated = (modules.find(path.to_node_id) != modules.end());
+
+		try {
+			if(from_replicated && to_replicated) {
+				path.from_port_info = modules.at(path.from_node_id)->getPort(path.from_port_id);
+				path.to_port_info = modules.at(path.to_node_id)->getPort(path.to_port_id);
+
+				path.from_port_info.port->connect(path.to_port_info.port);
+				path.to_port_info.port->connect(path.from_port_info.port);
+
+				paths.push_back(path);
+			} else if(from_replicated && primary_modules.find(path.to_node_id) != primary_modules.end()) {
+				const auto &primary_module = primary_modules.at(path.to_node_id);
+				addBridge(modules.at(path.from_node_id)->getPort(path.from_port_id).port, primary_module, primary_module->getPort(path.to_port_id));
+			} else if(to_replicated && primary_modules.find(path.from_node_id) != primary_modules.end()) {
+				const auto &primary_module = primary_modules.at(path.from_node_id);
+				addBridge(modules.at(path.to_node_id)->getPort(path.to_port_id).port, primary_module, primary_module->getPort(path.from_port_id));
+			}
+		} catch(const out_of_range &e) {
+			cerr << "Unknown node or port ID in replicated path!" << endl;
+		} catch(const incompatible_port_types &e) {
+			cerr << "Cannot connect incompatible port types in replicated path!" << endl;
+		}
+	}
+}
+
+void GraphReplica::addBridge(Port *replica_port, shared_ptr<Module> primary_module, const Module::PortInfo &primary_port_info) {
+	// Only packets pushed into the primary graph can be handed over, the
+	// other direction is covered by the primary graph itself
+	auto casted_primary_port = dynamic_cast<ReceivingPort<PacketRef>*>(primary_port_info.port);
+	if(casted_primary_port == nullptr || dynamic_cast<SendingPort<PacketRef>*>(replica_port) == nullptr) {
+		return;
+	}
+
+	// Handed over in batches through a lock-free ring, like paths between
+	// modules on different threads of the primary graph
+	Path path;
+	path.from_port_info.port = replica_port;
+	path.to_port_info.port = casted_primary_port;
+	path.link = make_shared<ThreadLink>(*primary_io_services.at(primary_module->getPortThread(primary_port_info)));
+	path.link->bridge(replica_port, casted_primary_port, primary_module);
+	paths.push_back(path);
+}
+
+void GraphReplica::removePaths() {
+	for(auto &path : paths) {
+		path.from_port_info.port->disconnect();
+		if(path.link) {
+			// The port of the primary graph stays connected
+			path.link->disconnect();
+		} else {
+			path.to_port_info.port->disconnect();
+		}
+	}
+	paths.clear();
+}
+
+void GraphReplica::clear() {
+	removePaths();
+	modules.clear();
+}
+
+GraphReplica::~GraphReplica() {
+	clear();
+}
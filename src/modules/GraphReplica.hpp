@@ -0,0 +1,67 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRAPH_REPLICA_HPP
+#define GRAPH_REPLICA_HPP
+
+#include <string>
+#include <map>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "Module.hpp"
+#include "Path.hpp"
+#include "../utils/Packet.hpp"
+
+#include <boost/asio.hpp>
+#include <json/json.h>
+
+// Copy of the replicable modules of a graph that runs on a worker thread.
+// Paths from replicated modules to modules that only exist in the primary
+// graph are bridged to the thread running the primary graph.
+class GraphReplica {
+	public:
+		GraphReplica(boost::asio::io_service &io_service, const std::vector<boost::asio::io_service*> &primary_io_services, unsigned int replica);
+		~GraphReplica();
+
+		void addModule(const std::string &id, std::shared_ptr<Module> module);
+
+		void update(const Json::Value &json_root, const std::map<std::string, std::shared_ptr<Module>> &primary_modules);
+		void updateModule(const std::string &id, const Json::Value &json_root);
+
+		// Must only be called while the worker thread is not running
+		void clear();
+
+	private:
+		boost::asio::io_service &io_service;
+		const std::vector<boost::asio::io_service*> primary_io_services;
+		const unsigned int replica;
+
+		std::map<std::string, std::shared_ptr<Module>> modules;
+		std::list<Path> paths;
+
+		void handleUpdate(const Json::Value &json_root, const std::map<std::string, std::shared_ptr<Module>> &primary_modules);
+		void addBridge(Port *replica_port, std::shared_ptr<Module> primary_module, const Module::PortInfo &primary_port_info);
+		void removePaths();
+};
+
+#endif
@@ -25,15 +25,18 @@
 #include <string>
 #include <map>
 #include <list>
+#include <memory>
 #include <stdexcept>
+#include <utility>
 
+#include <boost/asio.hpp>
 #include <json/json.h>
 
 #include "Parameter.hpp"
 #include "Port.hpp"
 #include "Statistic.hpp"
 
-class Module {
+class Module : public std::enable_shared_from_this<Module> {
 	public:
 		struct PortInfo {
 			enum Side {left, right};
@@ -76,11 +79,78 @@ class Module {
 			return this->removable;
 		}
 
+		// Replicable modules treat every packet on its own, so that they can
+		// run once per worker thread on a share of the flows without changing
+		// the behavior of the graph. They may still hold packets, e.g. for a
+		// fixed delay, but must not depend on the packets of other flows.
+		void setReplicable(bool replicable) {
+			this->replicable = replicable;
+		}
+
+		bool getReplicable() const {
+			return this->replicable;
+		}
+
+		// Replicas are numbered from 1 on, the module of the primary graph
+		// is number 0. Modules with random generators derive their seed from
+		// it, so that the replicas do not draw the same numbers.
+		virtual void setReplica(unsigned int replica) {
+			this->replica = replica;
+		}
+
+		unsigned int getReplica() const {
+			return this->replica;
+		}
+
+		// Index of the graph thread whose I/O service the module has been
+		// created with
+		void setThread(unsigned int thread) {
+			this->thread = thread;
+		}
+
+		unsigned int getThread() const {
+			return this->thread;
+		}
+
+		// Directional modules keep the state of both directions apart, so
+		// that the right-to-left direction can run on a thread of its own
+		void setDirectional(bool directional) {
+			this->directional = directional;
+		}
+
+		bool getDirectional() const {
+			return this->directional;
+		}
+
+		void setRlThread(unsigned int rl_thread) {
+			this->rl_thread = rl_thread;
+		}
+
+		unsigned int getRlThread() const {
+			return this->rl_thread;
+		}
+
+		// Packets of the right-to-left direction enter a module on its right
+		// side and leave it on its left side
+		unsigned int getPortThread(const PortInfo &port_info) const {
+			const std::string type = port_info.port->getType();
+			const bool inbound = (type == "receiving" || type == "requesting");
+			if(inbound == (port_info.side == PortInfo::Side::right)) {
+				return rl_thread;
+			}
+
+			return thread;
+		}
+
 		Json::Value serialize() const {
 			Json::Value json_root;
 			json_root["title"] = name;
 			json_root["type"] = getType();
 			json_root["removable"] = removable;
+			json_root["thread"] = thread;
+			if(rl_thread != thread) {
+				json_root["rl_thread"] = rl_thread;
+			}
 
 			Json::Value json_position;
 			json_position["x"] = gui_position_x;
@@ -163,6 +233,12 @@ class Module {
 				for(const auto& item : json_root["content"]) {
 					if(item.get("type", "").asString() == "parameter" && item.isMember("value")) {
 						const std::string id = item.get("id", "").asString();
+
+						// Graphs might have been saved with a different socket backend
+						if(parameters.find(id) == parameters.end()) {
+							continue;
+						}
+
 						const auto parameter = getParameter(id).parameter;
 						const Json::Value value = item.get("value", 0);
 						
@@ -246,9 +322,25 @@ class Module {
 			statistics[statistic_info.id] = statistic_info;
 		}
 
+		// Posted handlers only hold a weak reference to the module, so they
+		// are skipped if the module has been removed before they run
+		template<typename Executor, typename Handler>
+		void post(Executor &&executor, Handler &&handler) {
+			boost::asio::post(std::forward<Executor>(executor), [owner = weak_from_this(), handler = std::forward<Handler>(handler)]() mutable {
+				if(auto module = owner.lock()) {
+					handler();
+				}
+			});
+		}
+
 	private:
 		std::string name = "UNNAMED MODULE";
 		bool removable = true;
+		bool replicable = false;
+		unsigned int replica = 0;
+		bool directional = false;
+		unsigned int thread = 0;
+		unsigned int rl_thread = 0;
 
 		std::map<std::string, PortInfo> ports;
 		std::list<PortInfo> ports_info_left;
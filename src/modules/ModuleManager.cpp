@@ -48,6 +48,10 @@
 #include "rate/BitrateRateModule.hpp"
 #include "rate/FixedIntervalRateModule.hpp"
 #include "rate/TraceRateModule.hpp"
+#include "segmentation/SegmentationModule.hpp"
+#include "traffic/PcapReplayModule.hpp"
+#include "traffic/TrafficGeneratorModule.hpp"
+#include "traffic/TrafficSinkModule.hpp"
 
 using namespace std;
 
@@ -68,12 +72,16 @@ map<string, ModuleManager::ModuleInfo> ModuleManager::module_library = {
 	{"bitrate_rate", {"Rate", new ModuleFactory<BitrateRateModule>}},
 	{"fixed_interval_rate", {"Rate", new ModuleFactory<FixedIntervalRateModule>}},
 	{"trace_rate", {"Rate", new ModuleFactory<TraceRateModule>}},
+	{"segmentation", {"Segmentation", new ModuleFactory<SegmentationModule>}},
 	{"delay_meter", {"Meter", new ModuleFactory<DelayMeter>}},
 	{"throughput_meter", {"Meter", new ModuleFactory<ThroughputMeter>}},
+	{"traffic_generator", {"Traffic", new ModuleFactory<TrafficGeneratorModule>}},
+	{"traffic_sink", {"Traffic", new ModuleFactory<TrafficSinkModule>}},
+	{"pcap_replay", {"Traffic", new ModuleFactory<PcapReplayModule>}},
 	{"null", {"", new ModuleFactory<NullModule>}}
 };
 
-ModuleManager::ModuleManager(boost::asio::io_service &io_service, Mqtt &mqtt) : io_service(io_service), mqtt(mqtt) {
+ModuleManager::ModuleManager(boost::asio::io_service &io_service, Mqtt &mqtt) : io_service(io_service), mqtt(mqtt), thread_io_services({&io_service}) {
 	mqtt.publish("get/module_library", getModuleLibrary(), true, true);
 
 	mqtt.subscribeJson("set/module/+", [&](const string &topic, const Json::Value &json_root) {
@@ -93,10 +101,14 @@ ModuleManager::ModuleManager(boost::asio::io_service &io_service, Mqtt &mqtt) :
 		} else {
 			removeModule(node_id, true, true, false);
 		}
+
+		updateReplicas();
 	});
 
 	mqtt.subscribeJson("set/paths", [&](const string &topic, const Json::Value &json_root) {
 		updatePaths(json_root);
+
+		updateReplicas();
 	});
 
 	mqtt.subscribe("set/load", [&](const string &topic, const string &payload) {
@@ -148,13 +160,27 @@ Json::Value ModuleManager::getModuleLibrary() {
 void ModuleManager::addModule(const string &id, const Json::Value &json_root, bool publish) {
 	string type = json_root.get("type", "").asString();
 
+	unsigned int thread = json_root.get("thread", 0).asUInt();
+	if(thread >= thread_io_services.size()) {
+		cerr << "Thread " << thread << " of module " + id + " does not exist, using thread 0!" << endl;
+		thread = 0;
+	}
+
+	unsigned int rl_thread = json_root.get("rl_thread", default_rl_thread.value_or(thread)).asUInt();
+	if(rl_thread >= thread_io_services.size()) {
+		cerr << "Thread " << rl_thread << " of module " + id + " does not exist, using thread " << thread << "!" << endl;
+		rl_thread = thread;
+	}
+
 	shared_ptr<Module> new_module;
 	try {
-		new_module = module_library.at(type).factory->create(io_service);
+		new_module = module_library.at(type).factory->create(*thread_io_services[thread], *thread_io_services[rl_thread]);
 	} catch(const out_of_range &e) {
 		cerr << "Unknown module type: " << type << endl;
 		return;
 	}
+	new_module->setThread(thread);
+	new_module->setRlThread(new_module->getDirectional() ? rl_thread : thread);
 
 	addModule(id, new_module, false);
 	updateModule(id, json_root, publish);
@@ -193,6 +219,8 @@ void ModuleManager::addModule(const string &id, shared_ptr<Module> module, bool
 			mqtt.publish("get/module/" + id + "/" + parameter_id, to_string(parameter_double->get()), true, false);
 			parameter_double->addChangeHandler([&, id, parameter_id](double value_double) {
 				mqtt.publish("get/module/" + id + "/" + parameter_id, to_string(value_double), true, false);
+
+				updateReplicaModule(id);
 			});
 		} else if(const auto parameter_bool = dynamic_cast<ParameterBool*>(parameter)) {
 			mqtt.subscribe("set/module/" + id + "/" + parameter_id, [&, parameter_bool](const string &topic, const string &payload) {
@@ -208,6 +236,8 @@ void ModuleManager::addModule(const string &id, shared_ptr<Module> module, bool
 			mqtt.publish("get/module/" + id + "/" + parameter_id, to_string(parameter_bool->get()), true, false);
 			parameter_bool->addChangeHandler([&, id, parameter_id](bool value_bool) {
 				mqtt.publish("get/module/" + id + "/" + parameter_id, to_string(value_bool), true, false);
+
+				updateReplicaModule(id);
 			});
 		} else if(const auto parameter_string = dynamic_cast<ParameterString*>(parameter)) {
 			mqtt.subscribe("set/module/" + id + "/" + parameter_id, [&, parameter_string](const string &topic, const string &payload) {
@@ -217,6 +247,8 @@ void ModuleManager::addModule(const string &id, shared_ptr<Module> module, bool
 			mqtt.publish("get/module/" + id + "/" + parameter_id, parameter_string->get(), true, false);
 			parameter_string->addChangeHandler([&, id, parameter_id](string value_string) {
 				mqtt.publish("get/module/" + id + "/" + parameter_id, value_string, true, false);
+
+				updateReplicaModule(id);
 			});
 		} else if(const auto parameter_string_select = dynamic_cast<ParameterStringSelect*>(parameter)) {
 			mqtt.subscribe("set/module/" + id + "/" + parameter_id, [&, parameter_string_select](const string &topic, const string &payload) {
@@ -226,6 +258,8 @@ void ModuleManager::addModule(const string &id, shared_ptr<Module> module, bool
 			mqtt.publish("get/module/" + id + "/" + parameter_id, parameter_string_select->get(), true, false);
 			parameter_string_select->addChangeHandler([&, id, parameter_id](string value_string_select) {
 				mqtt.publish("get/module/" + id + "/" + parameter_id, value_string_select, true, false);
+
+				updateReplicaModule(id);
 			});
 
 			mqtt.publish("get/module/" + id + "/" + parameter_id + "/options", parameter_string_select->serializeOptions(), true, false);
@@ -343,12 +377,36 @@ void ModuleManager::addPath(Path path, bool publish) {
 		return;
 	}
 
-	try {
-		path.from_port_info.port->connect(path.to_port_info.port);
-		path.to_port_info.port->connect(path.from_port_info.port);
-	} catch(const incompatible_port_types &e) {
-		cerr << "Cannot connect incompatible port types!" << endl;
-		return;
+	const unsigned int from_thread = modules.at(path.from_node_id)->getPortThread(path.from_port_info);
+	const unsigned int to_thread = modules.at(path.to_node_id)->getPortThread(path.to_port_info);
+	if(from_thread != to_thread) {
+		// Paths can be drawn in either direction
+		Port *sending_port = path.from_port_info.port;
+		Port *receiving_port = path.to_port_info.port;
+		unsigned int receiving_thread = to_thread;
+		if(dynamic_cast<SendingPort<PacketRef>*>(sending_port) == nullptr) {
+			swap(sending_port, receiving_port);
+			receiving_thread = from_thread;
+		}
+
+		if(dynamic_cast<SendingPort<PacketRef>*>(sending_port) == nullptr || dynamic_cast<ReceivingPort<PacketRef>*>(receiving_port) == nullptr) {
+			cerr << "Cannot connect ports of modules on different threads that do not push packets!" << endl;
+			return;
+		}
+
+		path.link = make_shared<ThreadLink>(*thread_io_services[receiving_thread]);
+		path.link->getStatisticPacketsDropped().addHandler([&, topic = "get/path/" + path.from_node_id + "/" + path.from_port_id + "/" + path.to_node_id + "/" + path.to_port_id + "/packets_dropped"](double value) {
+			mqtt.publish(topic, to_string(value), true, true);
+		});
+		path.link->connect(sending_port, receiving_port);
+	} else {
+		try {
+			path.from_port_info.port->connect(path.to_port_info.port);
+			path.to_port_info.port->connect(path.from_port_info.port);
+		} catch(const incompatible_port_types &e) {
+			cerr << "Cannot connect incompatible port types!" << endl;
+			return;
+		}
 	}
 
 	cout << "Add path!" << endl;
@@ -367,9 +425,65 @@ shared_ptr<Module> ModuleManager::getModule(const string &id) {
 	}
 }
 
+shared_ptr<Module> ModuleManager::createModule(const string &type, boost::asio::io_service &io_service) {
+	try {
+		return module_library.at(type).factory->create(io_service);
+	} catch(const out_of_range &e) {
+		throw out_of_range("Unknown module type: " + type);
+	}
+}
+
+void ModuleManager::addThread(boost::asio::io_service &thread_io_service) {
+	thread_io_services.push_back(&thread_io_service);
+}
+
+const vector<boost::asio::io_service*>& ModuleManager::getThreadIoServices() const {
+	return thread_io_services;
+}
+
+void ModuleManager::setDefaultRlThread(unsigned int thread) {
+	default_rl_thread = thread;
+}
+
+void ModuleManager::addReplica(shared_ptr<GraphReplica> replica) {
+	replicas.push_back(replica);
+}
+
+void ModuleManager::updateReplicas() {
+	if(replicas.empty()) {
+		return;
+	}
+
+	const Json::Value json_root = serialize();
+	for(const auto& replica : replicas) {
+		replica->update(json_root, modules);
+	}
+}
+
+void ModuleManager::updateReplicaModule(const string &id) {
+	if(replicas.empty() || modules.find(id) == modules.end()) {
+		return;
+	}
+
+	const Json::Value json_root = modules.at(id)->serialize();
+	for(const auto& replica : replicas) {
+		replica->updateModule(id, json_root);
+	}
+}
+
+void ModuleManager::clearReplicas() {
+	for(const auto& replica : replicas) {
+		replica->clear();
+	}
+	replicas.clear();
+}
+
 list<Path>::iterator ModuleManager::removePath(list<Path>::iterator it, bool publish) {
 	it->from_port_info.port->disconnect();
 	it->to_port_info.port->disconnect();
+	if(it->link) {
+		it->link->disconnect();
+	}
 
 	cout << "Remove path!" << endl;
 	it = paths.erase(it);
@@ -466,6 +580,8 @@ Json::Value ModuleManager::serialize() {
 void ModuleManager::deserialize(const Json::Value &json_root, bool publish) {
 	updateModules(json_root["modules"], publish);
 	updatePaths(json_root["paths"], publish);
+
+	updateReplicas();
 }
 
 void ModuleManager::publishFiles(const string &path) {
@@ -25,9 +25,13 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
 
 #include "Module.hpp"
 #include "Path.hpp"
+#include "GraphReplica.hpp"
 #include "../utils/Mqtt.hpp"
 
 #include <boost/asio.hpp>
@@ -47,6 +51,22 @@ class ModuleManager {
 		void updateModules(const Json::Value &json_root, bool publish = true);
 		std::shared_ptr<Module> getModule(const std::string &id);
 
+		static std::shared_ptr<Module> createModule(const std::string &type, boost::asio::io_service &io_service);
+
+		// Modules are assigned to threads by their thread attribute, the
+		// first thread is the one running the I/O service given on
+		// construction
+		void addThread(boost::asio::io_service &thread_io_service);
+		const std::vector<boost::asio::io_service*>& getThreadIoServices() const;
+
+		// Thread that runs the right-to-left direction of directional
+		// modules that do not specify one themselves
+		void setDefaultRlThread(unsigned int thread);
+
+		void addReplica(std::shared_ptr<GraphReplica> replica);
+		void updateReplicas();
+		void clearReplicas();
+
 		void addPath(const Json::Value &json_root, bool publish = true);
 		void addPath(Path path, bool publish = true);
 		std::list<Path>::iterator removePath(std::list<Path>::iterator it, bool publish = true);
@@ -67,6 +87,7 @@ class ModuleManager {
 		class ModuleFactoryBase {
 			public:
 				virtual std::shared_ptr<Module> create(boost::asio::io_service &io_service) = 0;
+				virtual std::shared_ptr<Module> create(boost::asio::io_service &io_service, boost::asio::io_service &rl_io_service) = 0;
 		};
 
 		template<typename T> class ModuleFactory : public ModuleFactoryBase {
@@ -74,6 +95,15 @@ class ModuleManager {
 				virtual std::shared_ptr<Module> create(boost::asio::io_service &io_service) {
 					return std::make_shared<T>(io_service);
 				}
+
+				// Only modules with timers per direction take a second I/O service
+				virtual std::shared_ptr<Module> create(boost::asio::io_service &io_service, boost::asio::io_service &rl_io_service) {
+					if constexpr(std::is_constructible_v<T, boost::asio::io_service&, boost::asio::io_service&>) {
+						return std::make_shared<T>(io_service, rl_io_service);
+					} else {
+						return std::make_shared<T>(io_service);
+					}
+				}
 		};
 
 		struct ModuleInfo {
@@ -86,8 +116,14 @@ class ModuleManager {
 		boost::asio::io_service &io_service;
 		Mqtt &mqtt;
 
+		std::vector<boost::asio::io_service*> thread_io_services;
+		std::optional<unsigned int> default_rl_thread;
+
 		std::map<std::string, std::shared_ptr<Module>> modules;
 		std::list<Path> paths;
+
+		std::list<std::shared_ptr<GraphReplica>> replicas;
+		void updateReplicaModule(const std::string &id);
 };
 
 #endif
@@ -23,8 +23,10 @@
 #define PATH_HPP
 
 #include <string>
+#include <memory>
 
 #include "Module.hpp"
+#include "ThreadLink.hpp"
 
 struct Path {
 	std::string from_node_id;
@@ -35,6 +37,9 @@ struct Path {
 	Module::PortInfo from_port_info;
 	Module::PortInfo to_port_info;
 
+	// Set if the modules of the path run on different threads
+	std::shared_ptr<ThreadLink> link;
+
 	Json::Value serialize() const {
 		Json::Value json_root;
 
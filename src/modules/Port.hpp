@@ -23,8 +23,13 @@
 #define PORT_HPP
 
 #include <string>
+#include <atomic>
 #include <functional>
 #include <exception>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <limits>
 
 enum Side {left, right};
 
@@ -38,6 +43,60 @@ class Port {
 		virtual void disconnect() = 0;
 };
 
+// Class of a member function pointer that is given as template argument
+template<typename M> struct MemberFunctionClass;
+template<typename C, typename R, typename... Args> struct MemberFunctionClass<R (C::*)(Args...)> {
+	using type = C;
+};
+template<auto method> using MemberFunctionClassType = typename MemberFunctionClass<decltype(method)>::type;
+
+// View on consecutive packets that are passed between ports at once, e.g. all
+// frames received in one wakeup. Receivers may move packets out of it.
+template<typename T> class Span {
+	public:
+		Span(T *pointer, size_t length) : pointer(pointer), length(length) {
+		}
+		Span(std::vector<T> &vector) : Span(vector.data(), vector.size()) {
+		}
+
+		T* data() const {
+			return pointer;
+		}
+		size_t size() const {
+			return length;
+		}
+		bool empty() const {
+			return length == 0;
+		}
+
+		T& operator[](size_t index) const {
+			return pointer[index];
+		}
+		T* begin() const {
+			return pointer;
+		}
+		T* end() const {
+			return pointer + length;
+		}
+
+		Span first(size_t count) const {
+			return Span(pointer, count);
+		}
+
+	private:
+		T *pointer;
+		size_t length;
+};
+
+// Handlers are called through a plain function pointer and an object
+// pointer. Handlers given as member functions get a thunk that is resolved at
+// compile time, so that a packet passes from module to module without
+// std::function, bind or reference count updates. Sending and requesting
+// ports copy the handler of the connected port when the graph is connected.
+// Receiving ports without a batch handler hand batches to their receive
+// handler one packet at a time, responding ports without a batch handler
+// answer batch requests by calling their request handler repeatedly.
+
 template<typename T> class ReceivingPort;
 
 template<typename T> class SendingPort : virtual public Port {
@@ -53,21 +112,44 @@ template<typename T> class SendingPort : virtual public Port {
 			}
 
 			this->connected_port = casted_connected_port;
+			this->receive_thunk = casted_connected_port->receive_thunk;
+			this->receive_object = casted_connected_port->receive_object;
+			this->batch_thunk = casted_connected_port->batch_thunk;
+			this->batch_object = casted_connected_port->batch_object;
 		}
 
 		void disconnect() {
 			this->connected_port = nullptr;
+			this->receive_thunk = &ReceivingPort<T>::ignore;
+			this->receive_object = nullptr;
+			this->batch_thunk = &ReceivingPort<T>::ignoreBatch;
+			this->batch_object = nullptr;
 		}
 
 		void send(T packet) {
-			if(this->connected_port == nullptr) {
+			receive_thunk(receive_object, std::move(packet));
+		}
+
+		void send(Span<T> packets) {
+			if(packets.empty()) {
 				return;
 			}
 
-			connected_port->send(packet);
+			batch_thunk(batch_object, packets);
+		}
+
+		// Packets may only be sent ahead of their departure time if they go
+		// straight to a receiver that holds them back until then
+		bool getConnectedReleasesAtDepartureTime() const {
+			return connected_port != nullptr && connected_port->getReleasesAtDepartureTime();
 		}
 	protected:
 		ReceivingPort<T>* connected_port = nullptr;
+
+		typename ReceivingPort<T>::Thunk receive_thunk = &ReceivingPort<T>::ignore;
+		void *receive_object = nullptr;
+		typename ReceivingPort<T>::BatchThunk batch_thunk = &ReceivingPort<T>::ignoreBatch;
+		void *batch_object = nullptr;
 };
 
 template<typename T> class ReceivingPort : virtual public Port {
@@ -89,20 +171,74 @@ template<typename T> class ReceivingPort : virtual public Port {
 			this->connected_port = nullptr;
 		}
 
+		template<auto method> void setReceiveHandler(MemberFunctionClassType<method> *object) {
+			this->receive_thunk = [](void *object, T &&packet) {
+				(static_cast<MemberFunctionClassType<method>*>(object)->*method)(std::move(packet));
+			};
+			this->receive_object = object;
+		}
+
 		void setReceiveHandler(std::function<void(T)> handler) {
 			this->receive_handler = handler;
+			this->receive_thunk = [](void *object, T &&packet) {
+				auto &handler = *static_cast<std::function<void(T)>*>(object);
+				if(handler) {
+					handler(std::move(packet));
+				}
+			};
+			this->receive_object = &this->receive_handler;
+		}
+
+		template<auto method> void setBatchReceiveHandler(MemberFunctionClassType<method> *object) {
+			this->batch_thunk = [](void *object, Span<T> packets) {
+				(static_cast<MemberFunctionClassType<method>*>(object)->*method)(packets);
+			};
+			this->batch_object = object;
 		}
 
 		void send(T packet) {
-			try {
-				receive_handler(packet);
-			} catch(const std::bad_function_call &e) {
-			}
+			receive_thunk(receive_object, std::move(packet));
+		}
+
+		void send(Span<T> packets) {
+			batch_thunk(batch_object, packets);
+		}
+
+		// Set by receivers that release packets at their departure time, e.g.
+		// a socket with SO_TXTIME
+		void setReleasesAtDepartureTime(bool releases_at_departure_time) {
+			this->releases_at_departure_time = releases_at_departure_time;
+		}
+
+		bool getReleasesAtDepartureTime() const {
+			return releases_at_departure_time;
 		}
 
 	protected:
+		friend class SendingPort<T>;
+
+		std::atomic<bool> releases_at_departure_time = false;
+
 		SendingPort<T>* connected_port = nullptr;
 
+		using Thunk = void (*)(void *object, T &&packet);
+		static void ignore(void *object, T &&packet) {
+		}
+		Thunk receive_thunk = &ignore;
+		void *receive_object = nullptr;
+
+		using BatchThunk = void (*)(void *object, Span<T> packets);
+		static void ignoreBatch(void *object, Span<T> packets) {
+		}
+		static void receiveEach(void *object, Span<T> packets) {
+			auto port = static_cast<ReceivingPort<T>*>(object);
+			for(auto &packet : packets) {
+				port->receive_thunk(port->receive_object, std::move(packet));
+			}
+		}
+		BatchThunk batch_thunk = &receiveEach;
+		void *batch_object = this;
+
 		std::function<void(T)> receive_handler;
 };
 
@@ -121,36 +257,72 @@ template<typename T> class RequestingPort : virtual public Port {
 			}
 
 			this->connected_port = casted_connected_port;
+			this->request_thunk = casted_connected_port->request_thunk;
+			this->request_object = casted_connected_port->request_object;
+			this->batch_request_thunk = casted_connected_port->batch_request_thunk;
+			this->batch_request_object = casted_connected_port->batch_request_object;
 
 			notify();
 		}
 
 		void disconnect() {
 			this->connected_port = nullptr;
+			this->request_thunk = &RespondingPort<T>::ignore;
+			this->request_object = nullptr;
+			this->batch_request_thunk = &RespondingPort<T>::ignoreBatch;
+			this->batch_request_object = nullptr;
+		}
+
+		template<auto method> void setNotifyHandler(MemberFunctionClassType<method> *object) {
+			this->notify_thunk = [](void *object) {
+				(static_cast<MemberFunctionClassType<method>*>(object)->*method)();
+			};
+			this->notify_object = object;
 		}
 
 		void setNotifyHandler(std::function<void()> handler) {
 			this->notify_handler = handler;
+			this->notify_thunk = [](void *object) {
+				auto &handler = *static_cast<std::function<void()>*>(object);
+				if(handler) {
+					handler();
+				}
+			};
+			this->notify_object = &this->notify_handler;
 		}
 
 		T request() {
-			if(this->connected_port == nullptr) {
-				return T();
-			}
+			return request_thunk(request_object);
+		}
 
-			return connected_port->request();
+		// Appends up to the given number of packets, stops after the packet
+		// that reaches the given number of bytes, so that at least one packet
+		// is appended if available, and returns the number of appended
+		// packets
+		size_t requestBatch(std::vector<T> &packets, size_t max_packets, size_t max_bytes = std::numeric_limits<size_t>::max()) {
+			return batch_request_thunk(batch_request_object, packets, max_packets, max_bytes);
 		}
 
 		void notify() {
-			try {
-				notify_handler();
-			} catch(const std::bad_function_call &e) {
-			}
+			notify_thunk(notify_object);
 		}
 
 	protected:
+		friend class RespondingPort<T>;
+
 		RespondingPort<T>* connected_port = nullptr;
 
+		typename RespondingPort<T>::Thunk request_thunk = &RespondingPort<T>::ignore;
+		void *request_object = nullptr;
+		typename RespondingPort<T>::BatchThunk batch_request_thunk = &RespondingPort<T>::ignoreBatch;
+		void *batch_request_object = nullptr;
+
+		using Thunk = void (*)(void *object);
+		static void ignore(void *object) {
+		}
+		Thunk notify_thunk = &ignore;
+		void *notify_object = nullptr;
+
 		std::function<void()> notify_handler;
 };
 
@@ -173,17 +345,39 @@ template<typename T> class RespondingPort : virtual public Port {
 			this->connected_port = nullptr;
 		}
 
+		template<auto method> void setRequestHandler(MemberFunctionClassType<method> *object) {
+			this->request_thunk = [](void *object) -> T {
+				return (static_cast<MemberFunctionClassType<method>*>(object)->*method)();
+			};
+			this->request_object = object;
+		}
+
 		void setRequestHandler(std::function<T()> handler) {
 			this->request_handler = handler;
+			this->request_thunk = [](void *object) -> T {
+				auto &handler = *static_cast<std::function<T()>*>(object);
+				if(handler) {
+					return handler();
+				}
+
+				return T();
+			};
+			this->request_object = &this->request_handler;
+		}
+
+		template<auto method> void setBatchRequestHandler(MemberFunctionClassType<method> *object) {
+			this->batch_request_thunk = [](void *object, std::vector<T> &packets, size_t max_packets, size_t max_bytes) -> size_t {
+				return (static_cast<MemberFunctionClassType<method>*>(object)->*method)(packets, max_packets, max_bytes);
+			};
+			this->batch_request_object = object;
 		}
 
 		T request() {
-			try {
-				return request_handler();
-			} catch(const std::bad_function_call &e) {
-			}
+			return request_thunk(request_object);
+		}
 
-			return T();
+		size_t requestBatch(std::vector<T> &packets, size_t max_packets, size_t max_bytes = std::numeric_limits<size_t>::max()) {
+			return batch_request_thunk(batch_request_object, packets, max_packets, max_bytes);
 		}
 
 		void notify() {
@@ -195,8 +389,42 @@ template<typename T> class RespondingPort : virtual public Port {
 		}
 
 	protected:
+		friend class RequestingPort<T>;
+
 		RequestingPort<T>* connected_port = nullptr;
 
+		using Thunk = T (*)(void *object);
+		static T ignore(void *object) {
+			return T();
+		}
+		Thunk request_thunk = &ignore;
+		void *request_object = nullptr;
+
+		using BatchThunk = size_t (*)(void *object, std::vector<T> &packets, size_t max_packets, size_t max_bytes);
+		static size_t ignoreBatch(void *object, std::vector<T> &packets, size_t max_packets, size_t max_bytes) {
+			return 0;
+		}
+		static size_t requestEach(void *object, std::vector<T> &packets, size_t max_packets, size_t max_bytes) {
+			auto port = static_cast<RespondingPort<T>*>(object);
+
+			size_t count = 0;
+			size_t bytes = 0;
+			while(count < max_packets && (count == 0 || bytes < max_bytes)) {
+				T packet = port->request_thunk(port->request_object);
+				if(packet == nullptr) {
+					break;
+				}
+
+				bytes += packet->getBytes().size();
+				packets.push_back(std::move(packet));
+				count++;
+			}
+
+			return count;
+		}
+		BatchThunk batch_request_thunk = &requestEach;
+		void *batch_request_object = this;
+
 		std::function<T()> request_handler;
 };
 
@@ -0,0 +1,117 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadLink.hpp"
+
+#include <iterator>
+
+using namespace std;
+
+ThreadLink::ThreadLink(boost::asio::io_service &consumer_io_service) : consumer_io_service(consumer_io_service), ring(capacity) {
+	input_port.setReceiveHandler<&ThreadLink::receive>(this);
+	input_port.setBatchReceiveHandler<&ThreadLink::receiveBatch>(this);
+
+	drain_batch.reserve(max_batch_size);
+}
+
+void ThreadLink::connect(Port *sending_port, Port *receiving_port) {
+	sending_port->connect(&input_port);
+	input_port.connect(sending_port);
+
+	output_port.connect(receiving_port);
+	receiving_port->connect(&output_port);
+}
+
+void ThreadLink::bridge(Port *sending_port, Port *receiving_port, shared_ptr<void> receiver) {
+	this->receiver = receiver;
+
+	sending_port->connect(&input_port);
+	input_port.connect(sending_port);
+
+	output_port.connect(receiving_port);
+}
+
+void ThreadLink::disconnect() {
+	input_port.disconnect();
+	output_port.disconnect();
+}
+
+void ThreadLink::receive(PacketRef packet) {
+	push(move(packet));
+	scheduleDrain();
+}
+
+void ThreadLink::receiveBatch(Span<PacketRef> packets) {
+	for(auto &packet : packets) {
+		push(move(packet));
+	}
+	scheduleDrain();
+}
+
+void ThreadLink::push(PacketRef &&packet) {
+	// The reference count is not atomic and referenced memory belongs to
+	// the producing thread, so only packets without other handles and with
+	// their data in the packet pool are moved, all others are copied
+	if(!packet.unique()) {
+		packet = Packet::create(*packet);
+	} else {
+		packet->detachBytes();
+	}
+
+	if(!ring.push(move(packet))) {
+		packets_dropped.fetch_add(1, memory_order_relaxed);
+	}
+}
+
+void ThreadLink::scheduleDrain() {
+	if(drain_pending.exchange(true)) {
+		return;
+	}
+
+	boost::asio::post(consumer_io_service, [link = shared_from_this()]() {
+		link->drain();
+	});
+}
+
+void ThreadLink::drain() {
+	// Cleared before the ring is read, so that packets pushed from now on
+	// post another drain
+	drain_pending.exchange(false);
+
+	const uint64_t dropped = packets_dropped.load(memory_order_relaxed);
+	if(dropped != packets_dropped_published) {
+		packets_dropped_published = dropped;
+		statistic_packets_dropped.set(dropped);
+	}
+
+	// Bounded, so that a busy producer does not starve the other handlers
+	// of the consuming thread
+	for(size_t i = 0; i < capacity / max_batch_size; ++i) {
+		if(ring.pop(back_inserter(drain_batch), max_batch_size) == 0) {
+			return;
+		}
+
+		output_port.send(Span<PacketRef>(drain_batch));
+		drain_batch.clear();
+	}
+
+	scheduleDrain();
+}
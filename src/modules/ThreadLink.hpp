@@ -0,0 +1,85 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_LINK_HPP
+#define THREAD_LINK_HPP
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "Port.hpp"
+#include "Statistic.hpp"
+#include "../utils/Packet.hpp"
+#include "../utils/SpscRing.hpp"
+
+// Takes the place of a direct connection between a sending and a receiving
+// port of modules that run on different threads. Packets sent on the
+// producing thread are pushed to a bounded lock-free ring and forwarded in
+// batches on the consuming thread. Packets are dropped while the ring is full.
+class ThreadLink : public std::enable_shared_from_this<ThreadLink> {
+	public:
+		ThreadLink(boost::asio::io_service &consumer_io_service);
+
+		void connect(Port *sending_port, Port *receiving_port);
+		void disconnect();
+
+		// Only connects the receiving port to the link and not back, as it
+		// stays connected to its own sending port. The receiver is kept
+		// alive while packets may still be forwarded to it.
+		void bridge(Port *sending_port, Port *receiving_port, std::shared_ptr<void> receiver);
+
+		Statistic& getStatisticPacketsDropped() {
+			return statistic_packets_dropped;
+		}
+
+	private:
+		static constexpr size_t capacity = 4096;
+		static constexpr size_t max_batch_size = 64;
+
+		ReceivingPort<PacketRef> input_port;
+		SendingPort<PacketRef> output_port;
+
+		boost::asio::io_service &consumer_io_service;
+		std::shared_ptr<void> receiver;
+		SpscRing<PacketRef> ring;
+
+		void receive(PacketRef packet);
+		void receiveBatch(Span<PacketRef> packets);
+		void push(PacketRef &&packet);
+
+		// Counted on the producing thread, published on the consuming thread
+		std::atomic<uint64_t> packets_dropped = 0;
+		uint64_t packets_dropped_published = 0;
+		Statistic statistic_packets_dropped;
+
+		// Set while a drain is posted to the consuming thread, so that only
+		// the first packet after a drain posts a new one
+		std::atomic<bool> drain_pending = false;
+		std::vector<PacketRef> drain_batch;
+		void scheduleDrain();
+		void drain();
+};
+
+#endif
@@ -25,36 +25,61 @@
 
 using namespace std;
 
-FixedDelayModule::FixedDelayModule(boost::asio::io_service &io_service, double delay) : timer_lr(io_service), timer_rl(io_service) {
+FixedDelayModule::FixedDelayModule(boost::asio::io_service &io_service, boost::asio::io_service &rl_io_service, double delay) : timer_lr(io_service), timer_rl(rl_io_service) {
 	setName("Fixed Delay");
+	setReplicable(true);
+	setDirectional(true);
 	addPort({"lr_in", "In", PortInfo::Side::left, &input_port_lr});
 	addPort({"lr_out", "Out", PortInfo::Side::right, &output_port_lr});
 	addPort({"rl_in", "In", PortInfo::Side::right, &input_port_rl});
 	addPort({"rl_out", "Out", PortInfo::Side::left, &output_port_rl});
 	addParameter({"delay", "Delay", "ms", &parameter_delay});
+	addParameter({"tx_time", "TX Time", "", &parameter_tx_time});
 
-	input_port_lr.setReceiveHandler(bind(&FixedDelayModule::receiveFromLeftModule, this, placeholders::_1));
-	input_port_rl.setReceiveHandler(bind(&FixedDelayModule::receiveFromRightModule, this, placeholders::_1));
-
-	parameter_delay.addChangeHandler(bind(&FixedDelayModule::handleDelayChange, this));
+	input_port_lr.setReceiveHandler<&FixedDelayModule::receiveFromLeftModule>(this);
+	input_port_rl.setReceiveHandler<&FixedDelayModule::receiveFromRightModule>(this);
 
+	// Queues are empty until the module is connected, so the timers only
+	// need to be moved for later changes
 	parameter_delay.set(delay);
+
+	parameter_delay.addChangeHandler(bind(&FixedDelayModule::handleDelayChange, this));
 }
 
 void FixedDelayModule::handleDelayChange() {
-	setQueueTimeoutLr();
-	setQueueTimeoutRl();
+	// Timers are only touched by the thread of their direction
+	post(timer_lr.get_executor(), [this]() {
+		if(!packet_queue_lr.empty()) {
+			setQueueTimeoutLr();
+		}
+	});
+	post(timer_rl.get_executor(), [this]() {
+		if(!packet_queue_rl.empty()) {
+			setQueueTimeoutRl();
+		}
+	});
 }
 
-void FixedDelayModule::receiveFromLeftModule(shared_ptr<Packet> packet) {
+void FixedDelayModule::receiveFromLeftModule(PacketRef packet) {
 	if(parameter_delay.get() == 0.0) {
-		output_port_lr.send(packet);
+		output_port_lr.send(move(packet));
+		return;
+	}
+
+	// Forward the packet right away and leave its release to the socket,
+	// if it goes straight to one that holds it back until its departure
+	// time. Otherwise it is held here and stamped on its way out.
+	if(parameter_tx_time.get() && output_port_lr.getConnectedReleasesAtDepartureTime()) {
+		const auto departure_time_point = packet->hasDepartureTimePoint() ? packet->getDepartureTimePoint() : chrono::high_resolution_clock::now();
+		packet->setDepartureTimePoint(departure_time_point + chrono::nanoseconds((uint64_t) (parameter_delay.get() * 1000000.0)));
+		packet->addHop(getType());
+		output_port_lr.send(move(packet));
 		return;
 	}
 
 	bool packet_queue_lr_empty = packet_queue_lr.empty();
 
-	packet_queue_lr.emplace(chrono::high_resolution_clock::now(), packet);
+	packet_queue_lr.emplace(chrono::high_resolution_clock::now(), move(packet));
 
 	if(packet_queue_lr_empty) {
 		setQueueTimeoutLr();
@@ -72,11 +97,17 @@ void FixedDelayModule::processQueueLr(const boost::system::error_code& error) {
 		return;
 	}
 
-	chrono::high_resolution_clock::time_point chrono_deadline = chrono::high_resolution_clock::now() - chrono::nanoseconds((uint64_t) (parameter_delay.get() * 1000000.0));
+	const auto delay = chrono::nanoseconds((uint64_t) (parameter_delay.get() * 1000000.0));
+	chrono::high_resolution_clock::time_point chrono_deadline = chrono::high_resolution_clock::now() - delay;
+	const bool tx_time = parameter_tx_time.get();
 
 	while(!packet_queue_lr.empty()) {
 		if(packet_queue_lr.front().first <= chrono_deadline) {
-			output_port_lr.send(packet_queue_lr.front().second);
+			if(tx_time) {
+				packet_queue_lr.front().second->setDepartureTimePoint(packet_queue_lr.front().first + delay);
+			}
+			packet_queue_lr.front().second->addHop(getType());
+			output_port_lr.send(move(packet_queue_lr.front().second));
 			packet_queue_lr.pop();
 		} else {
 			setQueueTimeoutLr();
@@ -85,15 +116,26 @@ void FixedDelayModule::processQueueLr(const boost::system::error_code& error) {
 	}
 }
 
-void FixedDelayModule::receiveFromRightModule(shared_ptr<Packet> packet) {
+void FixedDelayModule::receiveFromRightModule(PacketRef packet) {
 	if(parameter_delay.get() == 0.0) {
-		output_port_rl.send(packet);
+		output_port_rl.send(move(packet));
+		return;
+	}
+
+	// Forward the packet right away and leave its release to the socket,
+	// if it goes straight to one that holds it back until its departure
+	// time. Otherwise it is held here and stamped on its way out.
+	if(parameter_tx_time.get() && output_port_rl.getConnectedReleasesAtDepartureTime()) {
+		const auto departure_time_point = packet->hasDepartureTimePoint() ? packet->getDepartureTimePoint() : chrono::high_resolution_clock::now();
+		packet->setDepartureTimePoint(departure_time_point + chrono::nanoseconds((uint64_t) (parameter_delay.get() * 1000000.0)));
+		packet->addHop(getType());
+		output_port_rl.send(move(packet));
 		return;
 	}
 
 	bool packet_queue_rl_empty = packet_queue_rl.empty();
 
-	packet_queue_rl.emplace(chrono::high_resolution_clock::now(), packet);
+	packet_queue_rl.emplace(chrono::high_resolution_clock::now(), move(packet));
 
 	if(packet_queue_rl_empty) {
 		setQueueTimeoutRl();
@@ -111,11 +153,17 @@ void FixedDelayModule::processQueueRl(const boost::system::error_code& error) {
 		return;
 	}
 
-	chrono::high_resolution_clock::time_point chrono_deadline = chrono::high_resolution_clock::now() - chrono::nanoseconds((uint64_t) (parameter_delay.get() * 1000000.0));
+	const auto delay = chrono::nanoseconds((uint64_t) (parameter_delay.get() * 1000000.0));
+	chrono::high_resolution_clock::time_point chrono_deadline = chrono::high_resolution_clock::now() - delay;
+	const bool tx_time = parameter_tx_time.get();
 
 	while(!packet_queue_rl.empty()) {
 		if(packet_queue_rl.front().first <= chrono_deadline) {
-			output_port_rl.send(packet_queue_rl.front().second);
+			if(tx_time) {
+				packet_queue_rl.front().second->setDepartureTimePoint(packet_queue_rl.front().first + delay);
+			}
+			packet_queue_rl.front().second->addHop(getType());
+			output_port_rl.send(move(packet_queue_rl.front().second));
 			packet_queue_rl.pop();
 		} else {
 			setQueueTimeoutRl();
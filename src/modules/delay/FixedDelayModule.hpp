@@ -23,7 +23,6 @@
 #define FIXED_DELAY_MODULE_HPP
 
 #include <cstdint>
-#include <queue>
 #include <utility>
 #include <chrono>
 
@@ -31,11 +30,14 @@
 
 #include "../Module.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/PacketQueue.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class FixedDelayModule : public Module {
 	public:
-		FixedDelayModule(boost::asio::io_service &io_service, double delay);
-		FixedDelayModule(boost::asio::io_service &io_service) : FixedDelayModule(io_service, 50.0) {};
+		FixedDelayModule(boost::asio::io_service &io_service, boost::asio::io_service &rl_io_service, double delay);
+		FixedDelayModule(boost::asio::io_service &io_service, boost::asio::io_service &rl_io_service) : FixedDelayModule(io_service, rl_io_service, 50.0) {};
+		FixedDelayModule(boost::asio::io_service &io_service) : FixedDelayModule(io_service, io_service) {};
 		~FixedDelayModule();
 
 		const char* getType() const {
@@ -46,20 +48,21 @@ class FixedDelayModule : public Module {
 
 	private:
 		ParameterDouble parameter_delay = {0.0, 0.0, std::numeric_limits<double>::quiet_NaN(), 10.0};
+		ParameterBool parameter_tx_time = false;
 
-		ReceivingPort<std::shared_ptr<Packet>> input_port_lr;
-		SendingPort<std::shared_ptr<Packet>> output_port_lr;
-		void receiveFromLeftModule(std::shared_ptr<Packet> packet);
-		boost::asio::high_resolution_timer timer_lr;
-		std::queue<std::pair<std::chrono::high_resolution_clock::time_point, std::shared_ptr<Packet>>> packet_queue_lr;
+		ReceivingPort<PacketRef> input_port_lr;
+		SendingPort<PacketRef> output_port_lr;
+		void receiveFromLeftModule(PacketRef packet);
+		WheelTimer timer_lr;
+		PacketQueue<std::pair<std::chrono::high_resolution_clock::time_point, PacketRef>> packet_queue_lr;
 		void setQueueTimeoutLr();
 		void processQueueLr(const boost::system::error_code& error);
 
-		ReceivingPort<std::shared_ptr<Packet>> input_port_rl;
-		SendingPort<std::shared_ptr<Packet>> output_port_rl;
-		void receiveFromRightModule(std::shared_ptr<Packet> packet);
-		boost::asio::high_resolution_timer timer_rl;
-		std::queue<std::pair<std::chrono::high_resolution_clock::time_point, std::shared_ptr<Packet>>> packet_queue_rl;
+		ReceivingPort<PacketRef> input_port_rl;
+		SendingPort<PacketRef> output_port_rl;
+		void receiveFromRightModule(PacketRef packet);
+		WheelTimer timer_rl;
+		PacketQueue<std::pair<std::chrono::high_resolution_clock::time_point, PacketRef>> packet_queue_rl;
 		void setQueueTimeoutRl();
 		void processQueueRl(const boost::system::error_code& error);
 };
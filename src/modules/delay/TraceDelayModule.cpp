@@ -21,6 +21,7 @@
 
 #include "TraceDelayModule.hpp"
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -29,36 +30,42 @@
 
 using namespace std;
 
-TraceDelayModule::TraceDelayModule(boost::asio::io_service &io_service, const string &traces_path, const string &trace_filename_lr, const string &trace_filename_rl) : timer_lr(io_service), timer_rl(io_service) {
+TraceDelayModule::TraceDelayModule(boost::asio::io_service &io_service, boost::asio::io_service &rl_io_service, const string &traces_path, const string &trace_filename_lr, const string &trace_filename_rl) : timer_lr(io_service), timer_rl(rl_io_service) {
 	setName("Trace Delay");
+	setDirectional(true);
 	addPort({"lr_in", "In", PortInfo::Side::left, &input_port_lr});
 	addPort({"lr_out", "Out", PortInfo::Side::right, &output_port_lr});
 	addPort({"rl_in", "In", PortInfo::Side::right, &input_port_rl});
 	addPort({"rl_out", "Out", PortInfo::Side::left, &output_port_rl});
 	addParameter({"lr_trace_filename", "🠒", "", &parameter_trace_filename_lr});
 	addParameter({"rl_trace_filename", "🠐", "", &parameter_trace_filename_rl});
+	addParameter({"tx_time", "TX Time", "", &parameter_tx_time});
 
-	input_port_lr.setReceiveHandler(bind(&TraceDelayModule::receiveFromLeftModule, this, placeholders::_1));
-	input_port_rl.setReceiveHandler(bind(&TraceDelayModule::receiveFromRightModule, this, placeholders::_1));
+	input_port_lr.setReceiveHandler<&TraceDelayModule::receiveFromLeftModule>(this);
+	input_port_rl.setReceiveHandler<&TraceDelayModule::receiveFromRightModule>(this);
 
 	parameter_trace_filename_lr.addChangeHandler([&, traces_path](string trace_filename_lr) {
-		unique_lock<mutex> trace_lr_lock(trace_lr_mutex);
+		{
+			unique_lock<mutex> trace_lr_lock(trace_lr_mutex);
 
-		try {
-			loadTrace(trace_lr, traces_path + "/" + trace_filename_lr);
-		} catch(const runtime_error &e) {
-			cerr << e.what() << endl;
+			try {
+				loadTrace(trace_lr, traces_path + "/" + trace_filename_lr);
+			} catch(const runtime_error &e) {
+				cerr << e.what() << endl;
+			}
 		}
 
 		reset();
 	});
 	parameter_trace_filename_rl.addChangeHandler([&, traces_path](string trace_filename_rl) {
-		unique_lock<mutex> trace_rl_lock(trace_rl_mutex);
+		{
+			unique_lock<mutex> trace_rl_lock(trace_rl_mutex);
 
-		try {
-			loadTrace(trace_rl, traces_path + "/" + trace_filename_rl);
-		} catch(const runtime_error &e) {
-			cerr << e.what() << endl;
+			try {
+				loadTrace(trace_rl, traces_path + "/" + trace_filename_rl);
+			} catch(const runtime_error &e) {
+				cerr << e.what() << endl;
+			}
 		}
 
 		reset();
@@ -133,18 +140,20 @@ void TraceDelayModule::loadTrace(vector<uint32_t> &trace, const string &trace_fi
 }
 
 void TraceDelayModule::reset() {
+	// Both directions start over at the beginning of their traces
+	scoped_lock trace_lock(trace_lr_mutex, trace_rl_mutex);
+
 	if(trace_lr.empty() || trace_rl.empty()) {
 		return;
 	}
 
+	// Queued packets keep the delay they have been given on arrival, so the
+	// timers of both directions are left alone
 	trace_lr_itr = trace_lr.begin();
 	trace_rl_itr = trace_rl.begin();
-
-	setQueueTimeoutLr();
-	setQueueTimeoutRl();
 }
 
-void TraceDelayModule::receiveFromLeftModule(shared_ptr<Packet> packet) {
+void TraceDelayModule::receiveFromLeftModule(PacketRef packet) {
 	unique_lock<mutex> trace_lr_lock(trace_lr_mutex);
 
 	if(trace_lr_itr == trace_lr.end()) {
@@ -152,9 +161,24 @@ void TraceDelayModule::receiveFromLeftModule(shared_ptr<Packet> packet) {
 	}
 	uint32_t delay = *(trace_lr_itr++);
 
+	// Forward the packet right away and leave its release to the socket,
+	// if it goes straight to one that holds it back until its departure
+	// time. Otherwise it is held here and stamped on its way out. Packets
+	// leave in the order they arrived, as they do from the queue, so the
+	// departure time never goes back even if the delay gets shorter.
+	if(parameter_tx_time.get() && output_port_lr.getConnectedReleasesAtDepartureTime()) {
+		const auto departure_time_point = packet->hasDepartureTimePoint() ? packet->getDepartureTimePoint() : chrono::high_resolution_clock::now();
+		last_departure_time_point_lr = max(last_departure_time_point_lr, departure_time_point + chrono::nanoseconds((uint64_t) delay * 1000000UL));
+		packet->setDepartureTimePoint(last_departure_time_point_lr);
+		trace_lr_lock.unlock();
+		packet->addHop(getType());
+		output_port_lr.send(move(packet));
+		return;
+	}
+
 	bool packet_queue_lr_empty = packet_queue_lr.empty();
 
-	packet_queue_lr.emplace(chrono::high_resolution_clock::now() + chrono::nanoseconds((uint64_t) delay * 1000000UL), packet);
+	packet_queue_lr.emplace(chrono::high_resolution_clock::now() + chrono::nanoseconds((uint64_t) delay * 1000000UL), move(packet));
 
 	if(packet_queue_lr_empty) {
 		setQueueTimeoutLr();
@@ -173,10 +197,16 @@ void TraceDelayModule::processQueueLr(const boost::system::error_code& error) {
 	}
 
 	chrono::high_resolution_clock::time_point chrono_deadline = chrono::high_resolution_clock::now();
+	const bool tx_time = parameter_tx_time.get();
 
 	while(!packet_queue_lr.empty()) {
 		if(packet_queue_lr.front().first <= chrono_deadline) {
-			output_port_lr.send(packet_queue_lr.front().second);
+			if(tx_time) {
+				last_departure_time_point_lr = max(last_departure_time_point_lr, packet_queue_lr.front().first);
+				packet_queue_lr.front().second->setDepartureTimePoint(last_departure_time_point_lr);
+			}
+			packet_queue_lr.front().second->addHop(getType());
+			output_port_lr.send(move(packet_queue_lr.front().second));
 			packet_queue_lr.pop();
 		} else {
 			setQueueTimeoutLr();
@@ -185,7 +215,7 @@ void TraceDelayModule::processQueueLr(const boost::system::error_code& error) {
 	}
 }
 
-void TraceDelayModule::receiveFromRightModule(shared_ptr<Packet> packet) {
+void TraceDelayModule::receiveFromRightModule(PacketRef packet) {
 	unique_lock<mutex> trace_rl_lock(trace_rl_mutex);
 
 	if(trace_rl_itr == trace_rl.end()) {
@@ -193,9 +223,24 @@ void TraceDelayModule::receiveFromRightModule(shared_ptr<Packet> packet) {
 	}
 	uint32_t delay = *(trace_rl_itr++);
 
+	// Forward the packet right away and leave its release to the socket,
+	// if it goes straight to one that holds it back until its departure
+	// time. Otherwise it is held here and stamped on its way out. Packets
+	// leave in the order they arrived, as they do from the queue, so the
+	// departure time never goes back even if the delay gets shorter.
+	if(parameter_tx_time.get() && output_port_rl.getConnectedReleasesAtDepartureTime()) {
+		const auto departure_time_point = packet->hasDepartureTimePoint() ? packet->getDepartureTimePoint() : chrono::high_resolution_clock::now();
+		last_departure_time_point_rl = max(last_departure_time_point_rl, departure_time_point + chrono::nanoseconds((uint64_t) delay * 1000000UL));
+		packet->setDepartureTimePoint(last_departure_time_point_rl);
+		trace_rl_lock.unlock();
+		packet->addHop(getType());
+		output_port_rl.send(move(packet));
+		return;
+	}
+
 	bool packet_queue_rl_empty = packet_queue_rl.empty();
 
-	packet_queue_rl.emplace(chrono::high_resolution_clock::now() + chrono::nanoseconds((uint64_t) delay * 1000000UL), packet);
+	packet_queue_rl.emplace(chrono::high_resolution_clock::now() + chrono::nanoseconds((uint64_t) delay * 1000000UL), move(packet));
 
 	if(packet_queue_rl_empty) {
 		setQueueTimeoutRl();
@@ -214,10 +259,16 @@ void TraceDelayModule::processQueueRl(const boost::system::error_code& error) {
 	}
 
 	chrono::high_resolution_clock::time_point chrono_deadline = chrono::high_resolution_clock::now();
+	const bool tx_time = parameter_tx_time.get();
 
 	while(!packet_queue_rl.empty()) {
 		if(packet_queue_rl.front().first <= chrono_deadline) {
-			output_port_rl.send(packet_queue_rl.front().second);
+			if(tx_time) {
+				last_departure_time_point_rl = max(last_departure_time_point_rl, packet_queue_rl.front().first);
+				packet_queue_rl.front().second->setDepartureTimePoint(last_departure_time_point_rl);
+			}
+			packet_queue_rl.front().second->addHop(getType());
+			output_port_rl.send(move(packet_queue_rl.front().second));
 			packet_queue_rl.pop();
 		} else {
 			setQueueTimeoutRl();
@@ -26,7 +26,6 @@
 #include <cstdint>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <utility>
 #include <vector>
 
@@ -34,11 +33,14 @@
 
 #include "../Module.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/PacketQueue.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class TraceDelayModule : public Module {
 	public:
-		TraceDelayModule(boost::asio::io_service &io_service, const std::string &traces_path, const std::string &trace_filename_lr, const std::string &trace_filename_rl);
-		TraceDelayModule(boost::asio::io_service &io_service) : TraceDelayModule(io_service, "config/traces/delay", "example", "example") {};
+		TraceDelayModule(boost::asio::io_service &io_service, boost::asio::io_service &rl_io_service, const std::string &traces_path, const std::string &trace_filename_lr, const std::string &trace_filename_rl);
+		TraceDelayModule(boost::asio::io_service &io_service, boost::asio::io_service &rl_io_service) : TraceDelayModule(io_service, rl_io_service, "config/traces/delay", "example", "example") {};
+		TraceDelayModule(boost::asio::io_service &io_service) : TraceDelayModule(io_service, io_service) {};
 		~TraceDelayModule();
 
 		const char* getType() const {
@@ -48,29 +50,32 @@ class TraceDelayModule : public Module {
 		void reset();
 
 	private:
-		ReceivingPort<std::shared_ptr<Packet>> input_port_lr;
-		SendingPort<std::shared_ptr<Packet>> output_port_lr;
-		ReceivingPort<std::shared_ptr<Packet>> input_port_rl;
-		SendingPort<std::shared_ptr<Packet>> output_port_rl;
+		ReceivingPort<PacketRef> input_port_lr;
+		SendingPort<PacketRef> output_port_lr;
+		ReceivingPort<PacketRef> input_port_rl;
+		SendingPort<PacketRef> output_port_rl;
 
 		ParameterStringSelect parameter_trace_filename_lr = {"", {}};
 		ParameterStringSelect parameter_trace_filename_rl = {"", {}};
+		ParameterBool parameter_tx_time = false;
 
 		std::vector<uint32_t> trace_lr;
 		std::vector<uint32_t>::iterator trace_lr_itr;
 		std::mutex trace_lr_mutex;
-		void receiveFromLeftModule(std::shared_ptr<Packet> packet);
-		boost::asio::high_resolution_timer timer_lr;
-		std::queue<std::pair<std::chrono::high_resolution_clock::time_point, std::shared_ptr<Packet>>> packet_queue_lr;
+		void receiveFromLeftModule(PacketRef packet);
+		WheelTimer timer_lr;
+		PacketQueue<std::pair<std::chrono::high_resolution_clock::time_point, PacketRef>> packet_queue_lr;
+		std::chrono::high_resolution_clock::time_point last_departure_time_point_lr;
 		void setQueueTimeoutLr();
 		void processQueueLr(const boost::system::error_code& error);
 
 		std::vector<uint32_t> trace_rl;
 		std::vector<uint32_t>::iterator trace_rl_itr;
 		std::mutex trace_rl_mutex;
-		void receiveFromRightModule(std::shared_ptr<Packet> packet);
-		boost::asio::high_resolution_timer timer_rl;
-		std::queue<std::pair<std::chrono::high_resolution_clock::time_point, std::shared_ptr<Packet>>> packet_queue_rl;
+		void receiveFromRightModule(PacketRef packet);
+		WheelTimer timer_rl;
+		PacketQueue<std::pair<std::chrono::high_resolution_clock::time_point, PacketRef>> packet_queue_rl;
+		std::chrono::high_resolution_clock::time_point last_departure_time_point_rl;
 		void setQueueTimeoutRl();
 		void processQueueRl(const boost::system::error_code& error);
 
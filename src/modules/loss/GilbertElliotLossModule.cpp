@@ -29,6 +29,7 @@ using namespace std;
 
 GilbertElliotLossModule::GilbertElliotLossModule(boost::asio::io_service &io_service, double p01, double p10, double e0, double e1, uint32_t seed_transition, uint32_t seed_loss) : timer_transition(io_service) {
 	setName("Gilbert-Elliot Loss");
+	setDirectional(true);
 	addPort({"lr_in", "In", PortInfo::Side::left, &input_port_lr});
 	addPort({"lr_out", "Out", PortInfo::Side::right, &output_port_lr});
 	addPort({"rl_in", "In", PortInfo::Side::right, &input_port_rl});
@@ -41,8 +42,10 @@ GilbertElliotLossModule::GilbertElliotLossModule(boost::asio::io_service &io_ser
 	addParameter({"seed_loss", "Loss Seed", "", &parameter_seed_loss});
 	addStatistic({"state", "State", "", &statistic_state});
 
-	input_port_lr.setReceiveHandler(bind(&GilbertElliotLossModule::receiveFromLeftModule, this, placeholders::_1));
-	input_port_rl.setReceiveHandler(bind(&GilbertElliotLossModule::receiveFromRightModule, this, placeholders::_1));
+	input_port_lr.setReceiveHandler<&GilbertElliotLossModule::receiveFromLeftModule>(this);
+	input_port_rl.setReceiveHandler<&GilbertElliotLossModule::receiveFromRightModule>(this);
+	input_port_lr.setBatchReceiveHandler<&GilbertElliotLossModule::receiveBatchFromLeftModule>(this);
+	input_port_rl.setBatchReceiveHandler<&GilbertElliotLossModule::receiveBatchFromRightModule>(this);
 
 	parameter_p01.addChangeHandler([&](double value) {
 		distribution_p01.reset(new exponential_distribution<double>(value));
@@ -74,7 +77,9 @@ void GilbertElliotLossModule::reset() {
 	timer_transition.cancel();
 
 	generator_transition.seed(parameter_seed_transition.get());
-	generator_loss.seed(parameter_seed_loss.get());
+	generator_loss_lr.seed(parameter_seed_loss.get());
+	seed_seq seed_loss_rl = {(uint32_t) parameter_seed_loss.get(), 1u};
+	generator_loss_rl.seed(seed_loss_rl);
 	state = 0;
 
 	chrono::high_resolution_clock::duration sojourn_time = chrono::nanoseconds((uint64_t) ((*distribution_p01)(generator_transition) * 1000000));
@@ -109,7 +114,7 @@ void GilbertElliotLossModule::transition(const boost::system::error_code& error)
 	statistic_state.set(state);
 }
 
-bool GilbertElliotLossModule::isLost() {
+bool GilbertElliotLossModule::isLost(mt19937 &generator_loss) {
 	if(state == 0) {
 		return (*distribution_e0)(generator_loss);
 	} else {
@@ -117,18 +122,42 @@ bool GilbertElliotLossModule::isLost() {
 	}
 }
 
-void GilbertElliotLossModule::receiveFromLeftModule(shared_ptr<Packet> packet) {
-	if(!isLost()) {
-		output_port_lr.send(packet);
+void GilbertElliotLossModule::receiveFromLeftModule(PacketRef packet) {
+	if(!isLost(generator_loss_lr)) {
+		output_port_lr.send(move(packet));
 	}
 }
 
-void GilbertElliotLossModule::receiveFromRightModule(shared_ptr<Packet> packet) {
-	if(!isLost()) {
-		output_port_rl.send(packet);
+void GilbertElliotLossModule::receiveFromRightModule(PacketRef packet) {
+	if(!isLost(getGeneratorLossRl())) {
+		output_port_rl.send(move(packet));
 	}
 }
 
+// Packets that are not lost are moved to the front and forwarded at once
+void GilbertElliotLossModule::receiveBatchFromLeftModule(Span<PacketRef> packets) {
+	size_t kept = 0;
+	for(auto &packet : packets) {
+		if(!isLost(generator_loss_lr)) {
+			packets[kept++] = move(packet);
+		}
+	}
+
+	output_port_lr.send(packets.first(kept));
+}
+
+void GilbertElliotLossModule::receiveBatchFromRightModule(Span<PacketRef> packets) {
+	auto &generator_loss = getGeneratorLossRl();
+	size_t kept = 0;
+	for(auto &packet : packets) {
+		if(!isLost(generator_loss)) {
+			packets[kept++] = move(packet);
+		}
+	}
+
+	output_port_rl.send(packets.first(kept));
+}
+
 GilbertElliotLossModule::~GilbertElliotLossModule() {
 	timer_transition.cancel();
 }
@@ -31,6 +31,7 @@
 
 #include "../Module.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class GilbertElliotLossModule : public Module {
 	public:
@@ -45,10 +46,10 @@ class GilbertElliotLossModule : public Module {
 		void reset();
 
 	private:
-		ReceivingPort<std::shared_ptr<Packet>> input_port_lr;
-		SendingPort<std::shared_ptr<Packet>> output_port_lr;
-		ReceivingPort<std::shared_ptr<Packet>> input_port_rl;
-		SendingPort<std::shared_ptr<Packet>> output_port_rl;
+		ReceivingPort<PacketRef> input_port_lr;
+		SendingPort<PacketRef> output_port_lr;
+		ReceivingPort<PacketRef> input_port_rl;
+		SendingPort<PacketRef> output_port_rl;
 
 		ParameterDouble parameter_p01 = {0.001, 0, std::numeric_limits<double>::quiet_NaN(), 0.001};
 		ParameterDouble parameter_p10 = {0.001, 0, std::numeric_limits<double>::quiet_NaN(), 0.001};
@@ -59,19 +60,31 @@ class GilbertElliotLossModule : public Module {
 		Statistic statistic_state;
 
 		std::mt19937 generator_transition;
-		std::mt19937 generator_loss;
+		// The channel state is shared. The right-to-left direction only
+		// draws its losses from a generator of its own if it runs on another
+		// thread, so that the losses for a seed do not change otherwise.
+		std::mt19937 generator_loss_lr;
+		std::mt19937 generator_loss_rl;
+
+		// Both directions share the generator of the left-to-right direction,
+		// unless they run on different threads
+		std::mt19937& getGeneratorLossRl() {
+			return (getRlThread() != getThread()) ? generator_loss_rl : generator_loss_lr;
+		}
 		std::unique_ptr<std::exponential_distribution<double>> distribution_p01;
 		std::unique_ptr<std::exponential_distribution<double>> distribution_p10;
 		std::unique_ptr<std::bernoulli_distribution> distribution_e0;
 		std::unique_ptr<std::bernoulli_distribution> distribution_e1;
 
-		void receiveFromLeftModule(std::shared_ptr<Packet> packet);
-		void receiveFromRightModule(std::shared_ptr<Packet> packet);
+		void receiveFromLeftModule(PacketRef packet);
+		void receiveFromRightModule(PacketRef packet);
+		void receiveBatchFromLeftModule(Span<PacketRef> packets);
+		void receiveBatchFromRightModule(Span<PacketRef> packets);
 
 		std::atomic<bool> state;
-		boost::asio::high_resolution_timer timer_transition;
+		WheelTimer timer_transition;
 		void transition(const boost::system::error_code& error);
-		bool isLost();
+		bool isLost(std::mt19937 &generator_loss);
 };
 
 #endif
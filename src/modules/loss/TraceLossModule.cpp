@@ -31,6 +31,7 @@ using namespace std;
 
 TraceLossModule::TraceLossModule(boost::asio::io_service &io_service, const string &traces_path, const string &trace_filename_lr, const string &trace_filename_rl) {
 	setName("Trace Loss");
+	setDirectional(true);
 	addPort({"lr_in", "In", PortInfo::Side::left, &input_port_lr});
 	addPort({"lr_out", "Out", PortInfo::Side::right, &output_port_lr});
 	addPort({"rl_in", "In", PortInfo::Side::right, &input_port_rl});
@@ -38,27 +39,33 @@ TraceLossModule::TraceLossModule(boost::asio::io_service &io_service, const stri
 	addParameter({"lr_trace_filename", "🠒", "", &parameter_trace_filename_lr});
 	addParameter({"rl_trace_filename", "🠐", "", &parameter_trace_filename_rl});
 
-	input_port_lr.setReceiveHandler(bind(&TraceLossModule::receiveFromLeftModule, this, placeholders::_1));
-	input_port_rl.setReceiveHandler(bind(&TraceLossModule::receiveFromRightModule, this, placeholders::_1));
+	input_port_lr.setReceiveHandler<&TraceLossModule::receiveFromLeftModule>(this);
+	input_port_rl.setReceiveHandler<&TraceLossModule::receiveFromRightModule>(this);
+	input_port_lr.setBatchReceiveHandler<&TraceLossModule::receiveBatchFromLeftModule>(this);
+	input_port_rl.setBatchReceiveHandler<&TraceLossModule::receiveBatchFromRightModule>(this);
 
 	parameter_trace_filename_lr.addChangeHandler([&, traces_path](string trace_filename_lr) {
-		unique_lock<mutex> trace_lr_lock(trace_lr_mutex);
+		{
+			unique_lock<mutex> trace_lr_lock(trace_lr_mutex);
 
-		try {
-			loadTrace(trace_lr, traces_path + "/" + trace_filename_lr);
-		} catch(const runtime_error &e) {
-			cerr << e.what() << endl;
+			try {
+				loadTrace(trace_lr, traces_path + "/" + trace_filename_lr);
+			} catch(const runtime_error &e) {
+				cerr << e.what() << endl;
+			}
 		}
 
 		reset();
 	});
 	parameter_trace_filename_rl.addChangeHandler([&, traces_path](string trace_filename_rl) {
-		unique_lock<mutex> trace_rl_lock(trace_rl_mutex);
+		{
+			unique_lock<mutex> trace_rl_lock(trace_rl_mutex);
 
-		try {
-			loadTrace(trace_rl, traces_path + "/" + trace_filename_rl);
-		} catch(const runtime_error &e) {
-			cerr << e.what() << endl;
+			try {
+				loadTrace(trace_rl, traces_path + "/" + trace_filename_rl);
+			} catch(const runtime_error &e) {
+				cerr << e.what() << endl;
+			}
 		}
 
 		reset();
@@ -114,6 +121,9 @@ void TraceLossModule::loadTrace(vector<bool> &trace, const string &trace_filenam
 }
 
 void TraceLossModule::reset() {
+	// Both directions start over at the beginning of their traces
+	scoped_lock trace_lock(trace_lr_mutex, trace_rl_mutex);
+
 	if(trace_lr.empty() || trace_rl.empty()) {
 		return;
 	}
@@ -122,7 +132,7 @@ void TraceLossModule::reset() {
 	trace_rl_itr = trace_rl.begin();
 }
 
-void TraceLossModule::receiveFromLeftModule(shared_ptr<Packet> packet) {
+void TraceLossModule::receiveFromLeftModule(PacketRef packet) {
 	unique_lock<mutex> trace_lr_lock(trace_lr_mutex);
 
 	if(trace_lr_itr == trace_lr.end()) {
@@ -130,11 +140,11 @@ void TraceLossModule::receiveFromLeftModule(shared_ptr<Packet> packet) {
 	}
 
 	if(*(trace_lr_itr++)) {
-		output_port_lr.send(packet);
+		output_port_lr.send(move(packet));
 	}
 }
 
-void TraceLossModule::receiveFromRightModule(shared_ptr<Packet> packet) {
+void TraceLossModule::receiveFromRightModule(PacketRef packet) {
 	unique_lock<mutex> trace_rl_lock(trace_rl_mutex);
 
 	if(trace_rl_itr == trace_rl.end()) {
@@ -142,6 +152,43 @@ void TraceLossModule::receiveFromRightModule(shared_ptr<Packet> packet) {
 	}
 
 	if(*(trace_rl_itr++)) {
-		output_port_rl.send(packet);
+		output_port_rl.send(move(packet));
+	}
+}
+
+// The trace is locked once per batch instead of once per packet
+void TraceLossModule::receiveBatchFromLeftModule(Span<PacketRef> packets) {
+	unique_lock<mutex> trace_lr_lock(trace_lr_mutex);
+
+	size_t kept = 0;
+	for(auto &packet : packets) {
+		if(trace_lr_itr == trace_lr.end()) {
+			trace_lr_itr = trace_lr.begin();
+		}
+
+		if(*(trace_lr_itr++)) {
+			packets[kept++] = move(packet);
+		}
 	}
+
+	trace_lr_lock.unlock();
+	output_port_lr.send(packets.first(kept));
+}
+
+void TraceLossModule::receiveBatchFromRightModule(Span<PacketRef> packets) {
+	unique_lock<mutex> trace_rl_lock(trace_rl_mutex);
+
+	size_t kept = 0;
+	for(auto &packet : packets) {
+		if(trace_rl_itr == trace_rl.end()) {
+			trace_rl_itr = trace_rl.begin();
+		}
+
+		if(*(trace_rl_itr++)) {
+			packets[kept++] = move(packet);
+		}
+	}
+
+	trace_rl_lock.unlock();
+	output_port_rl.send(packets.first(kept));
 }
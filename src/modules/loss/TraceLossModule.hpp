@@ -43,10 +43,10 @@ class TraceLossModule : public Module {
 		void reset();
 
 	private:
-		ReceivingPort<std::shared_ptr<Packet>> input_port_lr;
-		SendingPort<std::shared_ptr<Packet>> output_port_lr;
-		ReceivingPort<std::shared_ptr<Packet>> input_port_rl;
-		SendingPort<std::shared_ptr<Packet>> output_port_rl;
+		ReceivingPort<PacketRef> input_port_lr;
+		SendingPort<PacketRef> output_port_lr;
+		ReceivingPort<PacketRef> input_port_rl;
+		SendingPort<PacketRef> output_port_rl;
 
 		ParameterStringSelect parameter_trace_filename_lr = {"", {}};
 		ParameterStringSelect parameter_trace_filename_rl = {"", {}};
@@ -54,12 +54,14 @@ class TraceLossModule : public Module {
 		std::vector<bool> trace_lr;
 		std::vector<bool>::iterator trace_lr_itr;
 		std::mutex trace_lr_mutex;
-		void receiveFromLeftModule(std::shared_ptr<Packet> packet);
+		void receiveFromLeftModule(PacketRef packet);
+		void receiveBatchFromLeftModule(Span<PacketRef> packets);
 
 		std::vector<bool> trace_rl;
 		std::vector<bool>::iterator trace_rl_itr;
 		std::mutex trace_rl_mutex;
-		void receiveFromRightModule(std::shared_ptr<Packet> packet);
+		void receiveFromRightModule(PacketRef packet);
+		void receiveBatchFromRightModule(Span<PacketRef> packets);
 
 		void listTraces(const std::string &path);
 		void loadTrace(std::vector<bool> &trace, const std::string &trace_filename);
@@ -25,6 +25,8 @@ using namespace std;
 
 UncorrelatedLossModule::UncorrelatedLossModule(double loss, uint32_t seed) {
 	setName("Uncorrelated Loss");
+	setReplicable(true);
+	setDirectional(true);
 	addPort({"lr_in", "In", PortInfo::Side::left, &input_port_lr});
 	addPort({"lr_out", "Out", PortInfo::Side::right, &output_port_lr});
 	addPort({"rl_in", "In", PortInfo::Side::right, &input_port_rl});
@@ -32,28 +34,63 @@ UncorrelatedLossModule::UncorrelatedLossModule(double loss, uint32_t seed) {
 	addParameter({"loss", "Loss", "%", &parameter_loss});
 	addParameter({"seed", "Seed", "", &parameter_seed});
 
-	input_port_lr.setReceiveHandler(bind(&UncorrelatedLossModule::receiveFromLeftModule, this, placeholders::_1));
-	input_port_rl.setReceiveHandler(bind(&UncorrelatedLossModule::receiveFromRightModule, this, placeholders::_1));
+	input_port_lr.setReceiveHandler<&UncorrelatedLossModule::receiveFromLeftModule>(this);
+	input_port_rl.setReceiveHandler<&UncorrelatedLossModule::receiveFromRightModule>(this);
+	input_port_lr.setBatchReceiveHandler<&UncorrelatedLossModule::receiveBatchFromLeftModule>(this);
+	input_port_rl.setBatchReceiveHandler<&UncorrelatedLossModule::receiveBatchFromRightModule>(this);
 
 	parameter_loss.addChangeHandler([&](double value) {
 		distribution.reset(new bernoulli_distribution(value / 100));
 	});
 	parameter_seed.addChangeHandler([&](double value) {
-		generator_loss.seed(value);
+		const uint32_t seed = (uint32_t) value + getReplica();
+		generator_loss_lr.seed(seed);
+		seed_seq seed_rl = {seed, 1u};
+		generator_loss_rl.seed(seed_rl);
 	});
 
 	parameter_loss.set(loss);
 	parameter_seed.set(seed);
 }
 
-void UncorrelatedLossModule::receiveFromLeftModule(shared_ptr<Packet> packet) {
-	if(!(*distribution)(generator_loss)) {
-		output_port_lr.send(packet);
+void UncorrelatedLossModule::setReplica(unsigned int replica) {
+	Module::setReplica(replica);
+
+	parameter_seed.callChangeHandlers();
+}
+
+void UncorrelatedLossModule::receiveFromLeftModule(PacketRef packet) {
+	if(!(*distribution)(generator_loss_lr)) {
+		output_port_lr.send(move(packet));
+	}
+}
+
+void UncorrelatedLossModule::receiveFromRightModule(PacketRef packet) {
+	if(!(*distribution)(getGeneratorLossRl())) {
+		output_port_rl.send(move(packet));
 	}
 }
 
-void UncorrelatedLossModule::receiveFromRightModule(shared_ptr<Packet> packet) {
-	if(!(*distribution)(generator_loss)) {
-		output_port_rl.send(packet);
+// Packets that are not lost are moved to the front and forwarded at once
+void UncorrelatedLossModule::receiveBatchFromLeftModule(Span<PacketRef> packets) {
+	size_t kept = 0;
+	for(auto &packet : packets) {
+		if(!(*distribution)(generator_loss_lr)) {
+			packets[kept++] = move(packet);
+		}
 	}
+
+	output_port_lr.send(packets.first(kept));
+}
+
+void UncorrelatedLossModule::receiveBatchFromRightModule(Span<PacketRef> packets) {
+	auto &generator_loss = getGeneratorLossRl();
+	size_t kept = 0;
+	for(auto &packet : packets) {
+		if(!(*distribution)(generator_loss)) {
+			packets[kept++] = move(packet);
+		}
+	}
+
+	output_port_rl.send(packets.first(kept));
 }
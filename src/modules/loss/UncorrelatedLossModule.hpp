@@ -41,20 +41,34 @@ class UncorrelatedLossModule : public Module {
 			return "uncorrelated_loss";
 		}
 
+		void setReplica(unsigned int replica) override;
+
 	private:
-		ReceivingPort<std::shared_ptr<Packet>> input_port_lr;
-		SendingPort<std::shared_ptr<Packet>> output_port_lr;
-		ReceivingPort<std::shared_ptr<Packet>> input_port_rl;
-		SendingPort<std::shared_ptr<Packet>> output_port_rl;
+		ReceivingPort<PacketRef> input_port_lr;
+		SendingPort<PacketRef> output_port_lr;
+		ReceivingPort<PacketRef> input_port_rl;
+		SendingPort<PacketRef> output_port_rl;
 
 		ParameterDouble parameter_loss = {10, 0, 100, 1};
 		ParameterDouble parameter_seed = {1, 0, std::numeric_limits<double>::quiet_NaN(), 1};
 
-		std::mt19937 generator_loss;
+		// The right-to-left direction only draws from a generator of its
+		// own if it runs on another thread, so that the losses for a seed do
+		// not change otherwise. The seed is offset by the replica number.
+		std::mt19937 generator_loss_lr;
+		std::mt19937 generator_loss_rl;
+
+		// Both directions share the generator of the left-to-right direction,
+		// unless they run on different threads
+		std::mt19937& getGeneratorLossRl() {
+			return (getRlThread() != getThread()) ? generator_loss_rl : generator_loss_lr;
+		}
 		std::unique_ptr<std::bernoulli_distribution> distribution;
 
-		void receiveFromLeftModule(std::shared_ptr<Packet> packet);
-		void receiveFromRightModule(std::shared_ptr<Packet> packet);
+		void receiveFromLeftModule(PacketRef packet);
+		void receiveFromRightModule(PacketRef packet);
+		void receiveBatchFromLeftModule(Span<PacketRef> packets);
+		void receiveBatchFromRightModule(Span<PacketRef> packets);
 };
 
 #endif
@@ -33,20 +33,68 @@ DelayMeter::DelayMeter(boost::asio::io_service &io_service) : timer(io_service)
 	addPort({"out", "Out", PortInfo::Side::right, &output_port});
 	addParameter({"interval", "Interval", "ms", &parameter_interval});
 	addParameter({"window_size", "Window", "ms", &parameter_window_size});
+	addParameter({"reference", "Reference", "", &parameter_reference});
 	addStatistic({"min", "Min.", "ms", &statistic_min});
 	addStatistic({"max", "Max.", "ms", &statistic_max});
 	addStatistic({"mean", "Mean", "ms", &statistic_mean});
 
-	input_port.setReceiveHandler(bind(&DelayMeter::receive, this, placeholders::_1));
+	input_port.setReceiveHandler<&DelayMeter::receive>(this);
+	input_port.setBatchReceiveHandler<&DelayMeter::receiveBatch>(this);
+
+	parameter_reference.addChangeHandler([&](string value) {
+		Reference new_reference = Reference::creation;
+		if(value == "ingress") {
+			new_reference = Reference::ingress;
+		} else if(value == "last_hop") {
+			new_reference = Reference::last_hop;
+		}
+
+		// Modules only record hops while a meter reads them
+		const Reference old_reference = reference.exchange(new_reference);
+		if(old_reference != Reference::last_hop && new_reference == Reference::last_hop) {
+			Packet::addHopReader();
+		} else if(old_reference == Reference::last_hop && new_reference != Reference::last_hop) {
+			Packet::removeHopReader();
+		}
+	});
 
 	timer.expires_from_now(chrono::milliseconds(0));
 	timer.async_wait(boost::bind(&DelayMeter::process, this, boost::asio::placeholders::error));
 }
 
-void DelayMeter::receive(shared_ptr<Packet> packet) {
-	creation_time_points.emplace_back(chrono::high_resolution_clock::now(), packet->getCreationTimePoint());
+// Delay is measured from the creation of the packet in userspace, from its
+// reception by the kernel or from the last module that held it, so that
+// meters placed behind a module show the time spent in it
+chrono::high_resolution_clock::time_point DelayMeter::getReferenceTimePoint(const PacketRef &packet) const {
+	switch(reference) {
+		case Reference::ingress:
+			return packet->getIngressTimePoint();
+		case Reference::last_hop: {
+			const auto &annotations = packet->getAnnotations();
+			if(annotations.hop_count != 0) {
+				return annotations.hops[annotations.hop_count - 1].time_point;
+			}
+
+			return packet->getIngressTimePoint();
+		}
+		default:
+			return packet->getCreationTimePoint();
+	}
+}
+
+void DelayMeter::receive(PacketRef packet) {
+	creation_time_points.emplace_back(chrono::high_resolution_clock::now(), getReferenceTimePoint(packet));
 
-	output_port.send(packet);
+	output_port.send(move(packet));
+}
+
+void DelayMeter::receiveBatch(Span<PacketRef> packets) {
+	const auto now = chrono::high_resolution_clock::now();
+	for(const auto &packet : packets) {
+		creation_time_points.emplace_back(now, getReferenceTimePoint(packet));
+	}
+
+	output_port.send(packets);
 }
 
 void DelayMeter::process(const boost::system::error_code& error) {
@@ -99,4 +147,8 @@ void DelayMeter::process(const boost::system::error_code& error) {
 
 DelayMeter::~DelayMeter() {
 	timer.cancel();
+
+	if(reference == Reference::last_hop) {
+		Packet::removeHopReader();
+	}
 }
@@ -25,11 +25,13 @@
 #include <deque>
 #include <utility>
 #include <memory>
+#include <atomic>
 
 #include <boost/asio.hpp>
 
 #include "../Module.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class DelayMeter : public Module {
 	public:
@@ -41,18 +43,24 @@ class DelayMeter : public Module {
 		}
 
 	private:
-		ReceivingPort<std::shared_ptr<Packet>> input_port;
-		SendingPort<std::shared_ptr<Packet>> output_port;
+		ReceivingPort<PacketRef> input_port;
+		SendingPort<PacketRef> output_port;
 
 		ParameterDouble parameter_interval = {100, 0, std::numeric_limits<double>::quiet_NaN(), 100};
 		ParameterDouble parameter_window_size = {1000, 0, std::numeric_limits<double>::quiet_NaN(), 100};
+		ParameterStringSelect parameter_reference = {"creation", {"creation", "ingress", "last_hop"}};
 		Statistic statistic_min;
 		Statistic statistic_max;
 		Statistic statistic_mean;
 
-		void receive(std::shared_ptr<Packet> packet);
+		enum class Reference {creation, ingress, last_hop};
+		std::atomic<Reference> reference = Reference::creation;
 
-		boost::asio::high_resolution_timer timer;
+		std::chrono::high_resolution_clock::time_point getReferenceTimePoint(const PacketRef &packet) const;
+		void receive(PacketRef packet);
+		void receiveBatch(Span<PacketRef> packets);
+
+		WheelTimer timer;
 		std::deque<std::pair<std::chrono::high_resolution_clock::time_point, std::chrono::high_resolution_clock::time_point>> creation_time_points;
 		void process(const boost::system::error_code& error);
 };
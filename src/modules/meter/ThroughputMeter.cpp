@@ -35,19 +35,33 @@ ThroughputMeter::ThroughputMeter(boost::asio::io_service &io_service) : timer(io
 	addStatistic({"bytes_per_second", "Bytes", "B/s", &statistic_bytes_per_second});
 	addStatistic({"packets_per_second", "Packets", "packets/s", &statistic_packets_per_second});
 
-	input_port.setReceiveHandler(bind(&ThroughputMeter::receive, this, placeholders::_1));
+	input_port.setReceiveHandler<&ThroughputMeter::receive>(this);
+	input_port.setBatchReceiveHandler<&ThroughputMeter::receiveBatch>(this);
 
 	timer.expires_from_now(chrono::milliseconds(0));
 	timer.async_wait(boost::bind(&ThroughputMeter::process, this, boost::asio::placeholders::error));
 }
 
-void ThroughputMeter::receive(shared_ptr<Packet> packet) {
+void ThroughputMeter::receive(PacketRef packet) {
 	auto packet_size = packet->getBytes().size();
 
 	bytes_sum += packet_size;
 	bytes.emplace(chrono::high_resolution_clock::now(), packet_size);
 
-	output_port.send(packet);
+	output_port.send(move(packet));
+}
+
+// All packets of a batch arrived at the same time
+void ThroughputMeter::receiveBatch(Span<PacketRef> packets) {
+	const auto now = chrono::high_resolution_clock::now();
+	for(const auto &packet : packets) {
+		auto packet_size = packet->getBytes().size();
+
+		bytes_sum += packet_size;
+		bytes.emplace(now, packet_size);
+	}
+
+	output_port.send(packets);
 }
 
 void ThroughputMeter::process(const boost::system::error_code& error) {
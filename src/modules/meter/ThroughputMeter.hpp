@@ -31,6 +31,7 @@
 
 #include "../Module.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class ThroughputMeter : public Module {
 	public:
@@ -42,8 +43,8 @@ class ThroughputMeter : public Module {
 		}
 
 	private:
-		ReceivingPort<std::shared_ptr<Packet>> input_port;
-		SendingPort<std::shared_ptr<Packet>> output_port;
+		ReceivingPort<PacketRef> input_port;
+		SendingPort<PacketRef> output_port;
 
 		ParameterDouble parameter_interval = {100, 0, std::numeric_limits<double>::quiet_NaN(), 100};
 		ParameterDouble parameter_window_size = {1000, 0, std::numeric_limits<double>::quiet_NaN(), 100};
@@ -51,9 +52,10 @@ class ThroughputMeter : public Module {
 		Statistic statistic_bytes_per_second;
 		Statistic statistic_packets_per_second;
 
-		void receive(std::shared_ptr<Packet> packet);
+		void receive(PacketRef packet);
+		void receiveBatch(Span<PacketRef> packets);
 
-		boost::asio::high_resolution_timer timer;
+		WheelTimer timer;
 		uint64_t bytes_sum = 0;
 		std::queue<std::pair<std::chrono::high_resolution_clock::time_point, uint64_t>> bytes;
 		void process(const boost::system::error_code& error);
@@ -25,12 +25,18 @@ using namespace std;
 
 NullModule::NullModule() {
 	setName("Null");
+	setReplicable(true);
 	addPort({"in", "In", PortInfo::Side::left, &input_port});
 	addPort({"out", "Out", PortInfo::Side::right, &output_port});
 
-	input_port.setReceiveHandler(bind(&NullModule::receive, this, placeholders::_1));
+	input_port.setReceiveHandler<&NullModule::receive>(this);
+	input_port.setBatchReceiveHandler<&NullModule::receiveBatch>(this);
 }
 
-void NullModule::receive(shared_ptr<Packet> packet) {
-	output_port.send(packet);
+void NullModule::receive(PacketRef packet) {
+	output_port.send(move(packet));
+}
+
+void NullModule::receiveBatch(Span<PacketRef> packets) {
+	output_port.send(packets);
 }
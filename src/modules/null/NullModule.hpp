@@ -39,10 +39,11 @@ class NullModule : public Module {
 	}
 
 	private:
-		ReceivingPort<std::shared_ptr<Packet>> input_port;
-		SendingPort<std::shared_ptr<Packet>> output_port;
+		ReceivingPort<PacketRef> input_port;
+		SendingPort<PacketRef> output_port;
 
-		void receive(std::shared_ptr<Packet> packet);
+		void receive(PacketRef packet);
+		void receiveBatch(Span<PacketRef> packets);
 };
 
 #endif
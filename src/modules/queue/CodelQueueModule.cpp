@@ -52,9 +52,8 @@ CodelQueueModule::CodelQueueModule(boost::asio::io_service &io_service,
 	addStatistic(
 	    {"packets_marked", "Packets Marked", "", &statistic_packets_marked});
 
-	input_port.setReceiveHandler(
-	    bind(&CodelQueueModule::enqueue, this, placeholders::_1));
-	output_port.setRequestHandler(bind(&CodelQueueModule::dequeue, this));
+	input_port.setReceiveHandler<&CodelQueueModule::enqueue>(this);
+	output_port.setRequestHandler<&CodelQueueModule::dequeue>(this);
 
 	parameter_buffer_size.set(buffer_size);
 
@@ -75,7 +74,7 @@ CodelQueueModule::CodelQueueModule(boost::asio::io_service &io_service,
 	                                        boost::asio::placeholders::error));
 }
 
-void CodelQueueModule::enqueue(shared_ptr<Packet> packet) {
+void CodelQueueModule::enqueue(PacketRef packet) {
 	packets++;
 	if (packet_queue_timestamp.size() >= parameter_buffer_size.get()) {
 		packets_dropped++;
@@ -91,7 +90,7 @@ void CodelQueueModule::enqueue(shared_ptr<Packet> packet) {
 	return;
 }
 
-std::shared_ptr<Packet> CodelQueueModule::dequeue() {
+PacketRef CodelQueueModule::dequeue() {
 	auto now = chrono::high_resolution_clock::now();
 	dodequeue_result r = dodequeue(now);
 	bool ecn_capable_packet = false;
@@ -146,6 +145,9 @@ std::shared_ptr<Packet> CodelQueueModule::dequeue() {
 		drop_next_ = control_law(now, count);
 	}
 end:
+	if (r.packet != nullptr) {
+		r.packet->addHop(getType());
+	}
 	return r.packet;
 }
 
@@ -159,11 +161,11 @@ CodelQueueModule::time_point CodelQueueModule::control_law(time_point t,
 
 CodelQueueModule::dodequeue_result CodelQueueModule::dodequeue(time_point now) {
 	packet_with_timestamp packet_timestamped;
-	shared_ptr<Packet> packet;
+	PacketRef packet;
 	packet_timestamped = packet_with_timestamp{packet, now};
 
 	if (!packet_queue_timestamp.empty()) {
-		packet_timestamped = packet_queue_timestamp.front();
+		packet_timestamped = move(packet_queue_timestamp.front());
 		packet_queue_timestamp.pop();
 	}
 
@@ -29,10 +29,11 @@
 #include <boost/asio.hpp>
 #include <chrono>
 #include <memory>
-#include <queue>
 #include <random>
 
 #include "../../utils/Packet.hpp"
+#include "../../utils/PacketQueue.hpp"
+#include "../../utils/TimerWheel.hpp"
 #include "../Module.hpp"
 
 class CodelQueueModule : public Module {
@@ -40,12 +41,12 @@ class CodelQueueModule : public Module {
 	typedef std::chrono::milliseconds ms;
 
 	typedef struct packet_with_timestamp {
-		std::shared_ptr<Packet> packet;
+		PacketRef packet;
 		time_point arrival_time;
 	} packet_with_timestamp;
 
 	typedef struct dodequeue_result {
-		std::shared_ptr<Packet> packet;
+		PacketRef packet;
 		bool ok_to_drop;
 	} dodequeue_result;
 
@@ -69,8 +70,8 @@ private:
 	uint32_t lastcount = 0;
 	bool dropping_ = false;
 
-	ReceivingPort<std::shared_ptr<Packet>> input_port;
-	RespondingPort<std::shared_ptr<Packet>> output_port;
+	ReceivingPort<PacketRef> input_port;
+	RespondingPort<PacketRef> output_port;
 
 	ParameterBool parameter_ecn_mode = false;
 	ParameterDouble parameter_buffer_size = {
@@ -90,16 +91,16 @@ private:
 	uint64_t packets_dropped;
 	uint64_t packets_marked;
 
-	std::queue<packet_with_timestamp> packet_queue_timestamp;
+	PacketQueue<packet_with_timestamp> packet_queue_timestamp;
 
-	void enqueue(std::shared_ptr<Packet> packet);
-	std::shared_ptr<Packet> dequeue();
+	void enqueue(PacketRef packet);
+	PacketRef dequeue();
 
 	time_point control_law(time_point t, uint32_t count);
 
 	dodequeue_result dodequeue(time_point now);
 
-	boost::asio::high_resolution_timer timer_statistics;
+	WheelTimer timer_statistics;
 	void statistics(const boost::system::error_code &error);
 };
 
@@ -39,8 +39,8 @@ DQLQueueModule::DQLQueueModule(boost::asio::io_service &io_service, size_t buffe
 	addParameter({"epsilon", "Epsilon", "", &parameter_epsilon});
 	addStatistic({"queue_length", "Queue", "packets", &statistic_queue_length});
 
-	input_port.setReceiveHandler(bind(&DQLQueueModule::enqueue, this, placeholders::_1));
-	output_port.setRequestHandler(bind(&DQLQueueModule::dequeue, this));
+	input_port.setReceiveHandler<&DQLQueueModule::enqueue>(this);
+	output_port.setRequestHandler<&DQLQueueModule::dequeue>(this);
 
 	parameter_buffer_size.set(buffer_size);
 	parameter_epsilon.set(epsilon);
@@ -69,17 +69,17 @@ DQLQueueModule::DQLQueueModule(boost::asio::io_service &io_service, size_t buffe
 	timer_statistics.async_wait(boost::bind(&DQLQueueModule::statistics, this, boost::asio::placeholders::error));
 }
 
-void DQLQueueModule::enqueue(shared_ptr<Packet> packet) {
+void DQLQueueModule::enqueue(PacketRef packet) {
 	if(packet_queue.size() >= parameter_buffer_size.get()) {
 		return;
 	}
 
-	packet_queue.emplace(packet);
+	packet_queue.emplace(move(packet));
 
 	output_port.notify();
 }
 
-shared_ptr<Packet> DQLQueueModule::dequeue() {
+PacketRef DQLQueueModule::dequeue() {
 	auto observation = observation_tf.tensor<float, 2>();
 	auto observation_new = observation_new_tf.tensor<float, 2>();
 
@@ -92,11 +92,12 @@ shared_ptr<Packet> DQLQueueModule::dequeue() {
 	}
 
 	// Get packet
-	shared_ptr<Packet> packet;
+	PacketRef packet;
 	bool packet_sent = 0;
 	if(!packet_queue.empty()) {
-		packet = packet_queue.front();
+		packet = move(packet_queue.front());
 		packet_queue.pop();
+		packet->addHop(getType());
 		packet_sent = 1;
 	}
 
@@ -30,7 +30,6 @@
 
 #include <vector>
 #include <cstdint>
-#include <queue>
 #include <memory>
 #include <atomic>
 #include <thread>
@@ -41,6 +40,8 @@
 #include "../Module.hpp"
 #include "../../ml/DeepQLearning.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/PacketQueue.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class DQLQueueModule : public Module {
 	public:
@@ -53,8 +54,8 @@ class DQLQueueModule : public Module {
 		}
 
 	private:
-		ReceivingPort<std::shared_ptr<Packet>> input_port;
-		RespondingPort<std::shared_ptr<Packet>> output_port;
+		ReceivingPort<PacketRef> input_port;
+		RespondingPort<PacketRef> output_port;
 
 		ParameterDouble parameter_buffer_size = {100, 0, std::numeric_limits<double>::quiet_NaN(), 1};
 		ParameterDouble parameter_epsilon = {0.001, 0, 1, 0.001};
@@ -70,12 +71,12 @@ class DQLQueueModule : public Module {
 		std::unique_ptr<std::thread> training_thread;
 		std::atomic<bool> running;
 
-		std::queue<std::shared_ptr<Packet>> packet_queue;
+		PacketQueue<PacketRef> packet_queue;
 
-		void enqueue(std::shared_ptr<Packet> packet);
-		std::shared_ptr<Packet> dequeue();
+		void enqueue(PacketRef packet);
+		PacketRef dequeue();
 
-		boost::asio::high_resolution_timer timer_statistics;
+		WheelTimer timer_statistics;
 		void statistics(const boost::system::error_code& error);
 };
 
@@ -32,8 +32,9 @@ FifoQueueModule::FifoQueueModule(boost::asio::io_service &io_service, size_t buf
 	addParameter({"buffer_size", "Buffer", "packets", &parameter_buffer_size});
 	addStatistic({"queue_length", "Queue", "packets", &statistic_queue_length});
 
-	input_port.setReceiveHandler(bind(&FifoQueueModule::enqueue, this, placeholders::_1));
-	output_port.setRequestHandler(bind(&FifoQueueModule::dequeue, this));
+	input_port.setReceiveHandler<&FifoQueueModule::enqueue>(this);
+	input_port.setBatchReceiveHandler<&FifoQueueModule::enqueueBatch>(this);
+	output_port.setRequestHandler<&FifoQueueModule::dequeue>(this);
 
 	parameter_buffer_size.set(buffer_size);
 
@@ -42,21 +43,39 @@ FifoQueueModule::FifoQueueModule(boost::asio::io_service &io_service, size_t buf
 	timer_statistics.async_wait(boost::bind(&FifoQueueModule::statistics, this, boost::asio::placeholders::error));
 }
 
-void FifoQueueModule::enqueue(shared_ptr<Packet> packet) {
+void FifoQueueModule::enqueue(PacketRef packet) {
 	if(packet_queue.size() >= parameter_buffer_size.get()) {
 		return;
 	}
 
-	packet_queue.emplace(packet);
+	packet_queue.emplace(move(packet));
 
 	output_port.notify();
 }
 
-std::shared_ptr<Packet> FifoQueueModule::dequeue() {
-	shared_ptr<Packet> packet;
+// The module on the output side is only notified once per batch
+void FifoQueueModule::enqueueBatch(Span<PacketRef> packets) {
+	const size_t buffer_size = parameter_buffer_size.get();
+	const size_t packet_queue_size = packet_queue.size();
+	for(auto &packet : packets) {
+		if(packet_queue.size() >= buffer_size) {
+			break;
+		}
+
+		packet_queue.emplace(move(packet));
+	}
+
+	if(packet_queue.size() != packet_queue_size) {
+		output_port.notify();
+	}
+}
+
+PacketRef FifoQueueModule::dequeue() {
+	PacketRef packet;
 	if(!packet_queue.empty()) {
-		packet = packet_queue.front();
+		packet = move(packet_queue.front());
 		packet_queue.pop();
+		packet->addHop(getType());
 	}
 
 	return packet;
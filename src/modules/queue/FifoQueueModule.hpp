@@ -24,12 +24,13 @@
 
 #include <atomic>
 #include <memory>
-#include <queue>
 
 #include <boost/asio.hpp>
 
 #include "../Module.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/PacketQueue.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class FifoQueueModule : public Module {
 	public:
@@ -41,19 +42,20 @@ class FifoQueueModule : public Module {
 		}
 
 	private:
-		ReceivingPort<std::shared_ptr<Packet>> input_port;
-		RespondingPort<std::shared_ptr<Packet>> output_port;
+		ReceivingPort<PacketRef> input_port;
+		RespondingPort<PacketRef> output_port;
 
 		ParameterDouble parameter_buffer_size = {100, 1, std::numeric_limits<double>::quiet_NaN(), 1};
 
 		Statistic statistic_queue_length;
 
-		std::queue<std::shared_ptr<Packet>> packet_queue;
+		PacketQueue<PacketRef> packet_queue;
 
-		void enqueue(std::shared_ptr<Packet> packet);
-		std::shared_ptr<Packet> dequeue();
+		void enqueue(PacketRef packet);
+		void enqueueBatch(Span<PacketRef> packets);
+		PacketRef dequeue();
 
-		boost::asio::high_resolution_timer timer_statistics;
+		WheelTimer timer_statistics;
 		void statistics(const boost::system::error_code& error);
 };
 
@@ -48,9 +48,8 @@ Pi2QueueModule::Pi2QueueModule(boost::asio::io_service &io_service,
 	addStatistic(
 	    {"packets_marked", "Packets Marked", "", &statistic_packets_marked});
 
-	input_port.setReceiveHandler(
-	    bind(&Pi2QueueModule::enqueue, this, placeholders::_1));
-	output_port.setRequestHandler(bind(&Pi2QueueModule::dequeue, this));
+	input_port.setReceiveHandler<&Pi2QueueModule::enqueue>(this);
+	output_port.setRequestHandler<&Pi2QueueModule::dequeue>(this);
 
 	parameter_buffer_size.set(buffer_size);
 
@@ -104,7 +103,7 @@ void Pi2QueueModule::update_alpha_beta() {
 	beta = 0.3 / (static_cast<double>(rtt_max.count()) / 1000);
 }
 
-void Pi2QueueModule::enqueue(shared_ptr<Packet> packet) {
+void Pi2QueueModule::enqueue(PacketRef packet) {
 	uint8_t ecn = 0;
 	if (ecn_mode) {
 		ecn = packet->getECN();
@@ -114,7 +113,6 @@ void Pi2QueueModule::enqueue(shared_ptr<Packet> packet) {
 	if (drop_early(ecn)) {
 		if ((ecn == ECT0) || (ecn == ECT1)) {
 			packet->setECN(CONGESTION_EXPERIENCED);
-			packet->updateIPv4HeaderChecksum();
 			packets_marked++;
 		} else {
 			packets_dropped++;
@@ -134,17 +132,18 @@ void Pi2QueueModule::enqueue(shared_ptr<Packet> packet) {
 	output_port.notify();
 }
 
-std::shared_ptr<Packet>
+PacketRef
 Pi2QueueModule::dequeue() {
 	packet_with_timestamp packet_timestamped;
-	shared_ptr<Packet> packet;
+	PacketRef packet;
 
 	if (!packet_queue.empty()) {
-		packet_timestamped = packet_queue.front();
+		packet_timestamped = move(packet_queue.front());
 		packet_queue.pop();
 		packet = packet_timestamped.packet;
 		qdelay_current = chrono::duration_cast<chrono::milliseconds>(
 		    chrono::high_resolution_clock::now() - packet_timestamped.arrival_time);
+		packet->addHop(getType());
 	}
 
 	return packet;
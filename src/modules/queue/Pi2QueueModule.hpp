@@ -32,10 +32,11 @@
 #include <atomic>
 #include <boost/asio.hpp>
 #include <memory>
-#include <queue>
 #include <random>
 
 #include "../../utils/Packet.hpp"
+#include "../../utils/PacketQueue.hpp"
+#include "../../utils/TimerWheel.hpp"
 #include "../Module.hpp"
 
 class Pi2QueueModule : public Module {
@@ -43,7 +44,7 @@ class Pi2QueueModule : public Module {
 	typedef std::chrono::milliseconds ms;
 
 	typedef struct packet_with_timestamp {
-		std::shared_ptr<Packet> packet;
+		PacketRef packet;
 		time_point arrival_time;
 	} packet_with_timestamp;
 
@@ -57,8 +58,8 @@ public:
 private:
 	const double mark_ecnth = 0.1;
 
-	ReceivingPort<std::shared_ptr<Packet>> input_port;
-	RespondingPort<std::shared_ptr<Packet>> output_port;
+	ReceivingPort<PacketRef> input_port;
+	RespondingPort<PacketRef> output_port;
 
 	ParameterBool parameter_ecn_mode = false;
 	ParameterDouble parameter_buffer_size = {
@@ -97,17 +98,17 @@ private:
 	Statistic statistic_packets_dropped;
 	Statistic statistic_packets_marked;
 
-	std::queue<packet_with_timestamp> packet_queue;
+	PacketQueue<packet_with_timestamp> packet_queue;
 
-	void enqueue(std::shared_ptr<Packet> packet);
-	std::shared_ptr<Packet> dequeue();
+	void enqueue(PacketRef packet);
+	PacketRef dequeue();
 
 	void update_alpha_beta();
 	bool drop_early(uint8_t ecn);
-	boost::asio::high_resolution_timer timer_probability_update;
+	WheelTimer timer_probability_update;
 	void calculate_drop_prob(const boost::system::error_code &error);
 
-	boost::asio::high_resolution_timer timer_statistics;
+	WheelTimer timer_statistics;
 	void statistics(const boost::system::error_code &error);
 };
 
@@ -50,9 +50,8 @@ PieQueueModule::PieQueueModule(boost::asio::io_service &io_service,
 	addStatistic(
 	    {"packets_marked", "Packets Marked", "", &statistic_packets_marked});
 
-	input_port.setReceiveHandler(
-	    bind(&PieQueueModule::enqueue, this, placeholders::_1));
-	output_port.setRequestHandler(bind(&PieQueueModule::dequeue, this));
+	input_port.setReceiveHandler<&PieQueueModule::enqueue>(this);
+	output_port.setRequestHandler<&PieQueueModule::dequeue>(this);
 
 	parameter_seed.addChangeHandler([&](double value) {
 		generator.seed(value);
@@ -92,7 +91,7 @@ PieQueueModule::PieQueueModule(boost::asio::io_service &io_service,
 	                                        boost::asio::placeholders::error));
 }
 
-void PieQueueModule::enqueue(shared_ptr<Packet> packet) {
+void PieQueueModule::enqueue(PacketRef packet) {
 	bool ecn_capable_packet = false;
 	if (ecn_mode) {
 		uint8_t ecn = packet->getECN();
@@ -109,7 +108,6 @@ void PieQueueModule::enqueue(shared_ptr<Packet> packet) {
 	if ((burst_allowance == ms(0)) && (drop_early() == true)) {
 		if (ecn_capable_packet && (drop_prob <= mark_ecnth)) {
 			packet->setECN(CONGESTION_EXPERIENCED);
-			packet->updateIPv4HeaderChecksum();
 			packets_marked++;
 		} else {
 			packets_dropped++;
@@ -129,16 +127,17 @@ void PieQueueModule::enqueue(shared_ptr<Packet> packet) {
 	output_port.notify();
 }
 
-std::shared_ptr<Packet> PieQueueModule::dequeue() {
+PacketRef PieQueueModule::dequeue() {
 	packet_with_timestamp packet_timestamped;
-	shared_ptr<Packet> packet;
+	PacketRef packet;
 
 	if (!packet_queue.empty()) {
-		packet_timestamped = packet_queue.front();
+		packet_timestamped = move(packet_queue.front());
 		packet_queue.pop();
 		packet = packet_timestamped.packet;
 		qdelay_current = chrono::duration_cast<chrono::milliseconds>(
 		    chrono::high_resolution_clock::now() - packet_timestamped.arrival_time);
+		packet->addHop(getType());
 	} else {
 		qdelay_current = ms(0);
 	}
@@ -28,10 +28,11 @@
 #include <atomic>
 #include <boost/asio.hpp>
 #include <memory>
-#include <queue>
 #include <random>
 
 #include "../../utils/Packet.hpp"
+#include "../../utils/PacketQueue.hpp"
+#include "../../utils/TimerWheel.hpp"
 #include "../Module.hpp"
 
 class PieQueueModule : public Module {
@@ -39,7 +40,7 @@ class PieQueueModule : public Module {
 	typedef std::chrono::milliseconds ms;
 
 	typedef struct packet_with_timestamp {
-		std::shared_ptr<Packet> packet;
+		PacketRef packet;
 		time_point arrival_time;
 	} packet_with_timestamp;
 
@@ -56,8 +57,8 @@ private:
 	const ms t_update = ms(15);
 	const double mark_ecnth = 0.1;
 
-	ReceivingPort<std::shared_ptr<Packet>> input_port;
-	RespondingPort<std::shared_ptr<Packet>> output_port;
+	ReceivingPort<PacketRef> input_port;
+	RespondingPort<PacketRef> output_port;
 
 	ParameterBool parameter_ecn_mode = false;
 	ParameterDouble parameter_buffer_size = {
@@ -92,16 +93,16 @@ private:
 	std::mt19937 generator;
 	std::unique_ptr<std::uniform_real_distribution<double>> distribution;
 
-	std::queue<packet_with_timestamp> packet_queue;
+	PacketQueue<packet_with_timestamp> packet_queue;
 
-	void enqueue(std::shared_ptr<Packet> packet);
-	std::shared_ptr<Packet> dequeue();
+	void enqueue(PacketRef packet);
+	PacketRef dequeue();
 
 	bool drop_early();
-	boost::asio::high_resolution_timer timer_probability_update;
+	WheelTimer timer_probability_update;
 	void calculate_drop_prob(const boost::system::error_code &error);
 
-	boost::asio::high_resolution_timer timer_statistics;
+	WheelTimer timer_statistics;
 	void statistics(const boost::system::error_code &error);
 };
 
@@ -55,9 +55,8 @@ RedQueueModule::RedQueueModule(boost::asio::io_service &io_service,
 	addStatistic({"packets_dropped", "Packets Droppped", "", &statistic_packets_dropped});
 	addStatistic({"packets_marked", "Packets Marked", "", &statistic_packets_marked});
 
-	input_port.setReceiveHandler(
-	    bind(&RedQueueModule::receivePacket, this, placeholders::_1));
-	output_port.setRequestHandler(bind(&RedQueueModule::dequeue, this));
+	input_port.setReceiveHandler<&RedQueueModule::receivePacket>(this);
+	output_port.setRequestHandler<&RedQueueModule::dequeue>(this);
 
 	min_threshold = min_threshold_input;
 	max_threshold = max_threshold_input;
@@ -107,7 +106,7 @@ RedQueueModule::RedQueueModule(boost::asio::io_service &io_service,
 	                                        boost::asio::placeholders::error));
 }
 
-void RedQueueModule::receivePacket(shared_ptr<Packet> packet) {
+void RedQueueModule::receivePacket(PacketRef packet) {
 	bool packet_marked = false;
 	uint8_t ecn = 0;
 	if (ecn_mode) {
@@ -171,11 +170,12 @@ void RedQueueModule::receivePacket(shared_ptr<Packet> packet) {
 	return;
 }
 
-std::shared_ptr<Packet> RedQueueModule::dequeue() {
-	shared_ptr<Packet> packet;
+PacketRef RedQueueModule::dequeue() {
+	PacketRef packet;
 	if (!packet_queue.empty()) {
-		packet = packet_queue.front();
+		packet = move(packet_queue.front());
 		packet_queue.pop();
+		packet->addHop(getType());
 
 		if (packet_queue.empty()) {
 			q_time = chrono::high_resolution_clock::now();
@@ -31,10 +31,11 @@
 #include <boost/asio.hpp>
 #include <chrono>
 #include <memory>
-#include <queue>
 #include <random>
 
 #include "../../utils/Packet.hpp"
+#include "../../utils/PacketQueue.hpp"
+#include "../../utils/TimerWheel.hpp"
 #include "../Module.hpp"
 
 class RedQueueModule : public Module {
@@ -48,8 +49,8 @@ public:
 	const char *getType() const { return "red_queue"; }
 
 private:
-	ReceivingPort<std::shared_ptr<Packet>> input_port;
-	RespondingPort<std::shared_ptr<Packet>> output_port;
+	ReceivingPort<PacketRef> input_port;
+	RespondingPort<PacketRef> output_port;
 
 	ParameterDouble parameter_buffer_size = {
 	    100, 1, std::numeric_limits<double>::quiet_NaN(), 1};
@@ -87,12 +88,12 @@ private:
 	std::mt19937 generator;
 	std::unique_ptr<std::uniform_real_distribution<double>> distribution;
 
-	std::queue<std::shared_ptr<Packet>> packet_queue;
+	PacketQueue<PacketRef> packet_queue;
 
-	void receivePacket(std::shared_ptr<Packet> packet);
-	std::shared_ptr<Packet> dequeue();
+	void receivePacket(PacketRef packet);
+	PacketRef dequeue();
 
-	boost::asio::high_resolution_timer timer_statistics;
+	WheelTimer timer_statistics;
 	void statistics(const boost::system::error_code &error);
 };
 
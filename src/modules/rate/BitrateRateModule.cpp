@@ -25,46 +25,109 @@
 
 using namespace std;
 
+// Lead time with which packets are handed to the socket in TX time mode
+static constexpr chrono::microseconds tx_time_horizon(1000);
+
+// Maximum number of packets that are pulled from the queue at once
+static constexpr size_t max_batch_size = 64;
+
 BitrateRateModule::BitrateRateModule(boost::asio::io_service &io_service, uint64_t bitrate) : timer(io_service) {
 	setName("Bitrate Rate");
 	addPort({"in", "In", PortInfo::Side::left, &input_port});
 	addPort({"out", "Out", PortInfo::Side::right, &output_port});
 	addParameter({"bitrate", "Bitrate", "bit/s", &parameter_bitrate});
+	addParameter({"tx_time", "TX Time", "", &parameter_tx_time});
+	addParameter({"batch_time", "Batch Time", "ms", &parameter_batch_time});
 
-	input_port.setNotifyHandler([&]() {
-		if(current_transmission != nullptr) {
-			return;
-		}
-
-		timer.expires_at(chrono::high_resolution_clock::now());
-		timer.async_wait(boost::bind(&BitrateRateModule::process, this, boost::asio::placeholders::error));
-	});
+	input_port.setNotifyHandler<&BitrateRateModule::startTransmission>(this);
 
 	parameter_bitrate.set(bitrate);
 }
 
+void BitrateRateModule::startTransmission() {
+	if(transmitting) {
+		return;
+	}
+	transmitting = true;
+
+	// Packets handed over ahead of time might still be in transmission
+	transmission_end = max(transmission_end, chrono::high_resolution_clock::now());
+
+	timer.expires_at(chrono::high_resolution_clock::now());
+	timer.async_wait(boost::bind(&BitrateRateModule::process, this, boost::asio::placeholders::error));
+}
+
+// Number of bytes that are transmitted within the given duration
+size_t BitrateRateModule::getBatchBytes(uint64_t bitrate, chrono::high_resolution_clock::duration duration) const {
+	return (uint64_t) chrono::nanoseconds(duration).count() * (bitrate / 8) / 1000000000;
+}
+
 void BitrateRateModule::process(const boost::system::error_code& error) {
 	if(error == boost::asio::error::operation_aborted) {
 		return;
 	}
 
-	if(current_transmission != nullptr) {
-		output_port.send(current_transmission);
+	if(!current_transmissions.empty()) {
+		for(auto &packet : current_transmissions) {
+			packet->addHop(getType());
+		}
+		output_port.send(Span<PacketRef>(current_transmissions));
+		current_transmissions.clear();
 	}
 
 	uint64_t bitrate = parameter_bitrate.get();
 	if(bitrate == 0) {
+		transmitting = false;
 		return;
 	}
 
-	auto packet = input_port.request();
-	if(packet != nullptr) {
-		current_transmission = packet;
+	// With TX time, all packets that end their transmission within the
+	// horizon are forwarded at once and released by the socket, so the
+	// timer only fires once per horizon instead of once per packet. This
+	// requires the packets to go straight to a socket that holds them back,
+	// otherwise they are released here and only stamped.
+	const bool tx_time = parameter_tx_time.get();
+	if(tx_time && output_port.getConnectedReleasesAtDepartureTime()) {
+		const auto horizon = chrono::high_resolution_clock::now() + tx_time_horizon;
+		while(transmission_end <= horizon) {
+			if(input_port.requestBatch(current_transmissions, max_batch_size, getBatchBytes(bitrate, horizon - transmission_end)) == 0) {
+				transmitting = false;
+				return;
+			}
+
+			for(auto &packet : current_transmissions) {
+				transmission_end += chrono::nanoseconds((uint64_t) 1000000000 * packet->getBytes().size()*8 / bitrate);
+				packet->setDepartureTimePoint(transmission_end);
+				packet->addHop(getType());
+			}
+			output_port.send(Span<PacketRef>(current_transmissions));
+			current_transmissions.clear();
+		}
+
+		timer.expires_at(transmission_end - tx_time_horizon);
+		timer.async_wait(boost::bind(&BitrateRateModule::process, this, boost::asio::placeholders::error));
+		return;
+	}
+
+	// Packets that are transmitted within the batch time are pulled from
+	// the queue at once and forwarded together at the end of the last
+	// transmission, so that the timer does not fire once per packet at high
+	// bitrates. This delays all but the last packet of a batch and takes
+	// them from the queue early, so it is off by default and a batch holds
+	// a single packet.
+	const auto batch_time = chrono::nanoseconds((uint64_t) (parameter_batch_time.get() * 1000000.0));
+	if(input_port.requestBatch(current_transmissions, max_batch_size, getBatchBytes(bitrate, batch_time)) != 0) {
+		for(auto &packet : current_transmissions) {
+			transmission_end += chrono::nanoseconds((uint64_t) 1000000000 * packet->getBytes().size()*8 / bitrate);
+			if(tx_time) {
+				packet->setDepartureTimePoint(transmission_end);
+			}
+		}
 
-		timer.expires_at(timer.expiry() + chrono::nanoseconds((uint64_t) 1000000000 * packet->getBytes().size()*8 / bitrate));
+		timer.expires_at(transmission_end);
 		timer.async_wait(boost::bind(&BitrateRateModule::process, this, boost::asio::placeholders::error));
 	} else {
-		current_transmission = nullptr;
+		transmitting = false;
 	}
 }
 
@@ -27,11 +27,13 @@
 #include <utility>
 #include <atomic>
 #include <chrono>
+#include <vector>
 
 #include <boost/asio.hpp>
 
 #include "../Module.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class BitrateRateModule : public Module {
 	public:
@@ -44,13 +46,19 @@ class BitrateRateModule : public Module {
 		}
 
 	private:
-		RequestingPort<std::shared_ptr<Packet>> input_port;
-		SendingPort<std::shared_ptr<Packet>> output_port;
+		RequestingPort<PacketRef> input_port;
+		SendingPort<PacketRef> output_port;
 
 		ParameterDouble parameter_bitrate = {1000000, 0, std::numeric_limits<double>::quiet_NaN(), 1000};
+		ParameterBool parameter_tx_time = false;
+		ParameterDouble parameter_batch_time = {0, 0, std::numeric_limits<double>::quiet_NaN(), 0.1};
 
-		boost::asio::high_resolution_timer timer;
-		std::shared_ptr<Packet> current_transmission = nullptr;
+		WheelTimer timer;
+		bool transmitting = false;
+		std::vector<PacketRef> current_transmissions;
+		std::chrono::high_resolution_clock::time_point transmission_end;
+		void startTransmission();
+		size_t getBatchBytes(uint64_t bitrate, std::chrono::high_resolution_clock::duration duration) const;
 		void process(const boost::system::error_code& error);
 };
 
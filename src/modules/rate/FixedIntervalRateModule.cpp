@@ -25,6 +25,9 @@
 
 using namespace std;
 
+// Maximum number of intervals that are caught up at once
+static constexpr size_t max_batch_size = 64;
+
 FixedIntervalRateModule::FixedIntervalRateModule(boost::asio::io_service &io_service, chrono::high_resolution_clock::duration interval) : timer(io_service) {
 	setName("Fixed Interval Rate");
 	addPort({"lr_in", "In", PortInfo::Side::left, &input_port_lr});
@@ -62,17 +65,26 @@ void FixedIntervalRateModule::process(const boost::system::error_code& error) {
 		return;
 	}
 
-	auto packet_lr = input_port_lr.request();
-	if(packet_lr != nullptr) {
-		output_port_lr.send(packet_lr);
+	// Intervals that have passed while the timer was late are caught up at
+	// once instead of letting the timer fire for each of them
+	const auto interval = chrono::nanoseconds((uint64_t) (parameter_interval.get() * 1000000));
+	const auto now = chrono::high_resolution_clock::now();
+	auto expiry = timer.expiry();
+	size_t intervals = 1;
+	while(expiry + interval <= now && intervals < max_batch_size) {
+		expiry += interval;
+		intervals++;
 	}
 
-	auto packet_rl = input_port_rl.request();
-	if(packet_rl != nullptr) {
-		output_port_rl.send(packet_rl);
-	}
+	input_port_lr.requestBatch(batch, intervals);
+	output_port_lr.send(Span<PacketRef>(batch));
+	batch.clear();
+
+	input_port_rl.requestBatch(batch, intervals);
+	output_port_rl.send(Span<PacketRef>(batch));
+	batch.clear();
 
-	timer.expires_at(timer.expiry() + chrono::nanoseconds((uint64_t) (parameter_interval.get() * 1000000)));
+	timer.expires_at(expiry + interval);
 	timer.async_wait(boost::bind(&FixedIntervalRateModule::process, this, boost::asio::placeholders::error));
 }
 
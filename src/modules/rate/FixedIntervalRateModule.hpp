@@ -26,11 +26,13 @@
 #include <chrono>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include <boost/asio.hpp>
 
 #include "../Module.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class FixedIntervalRateModule : public Module {
 	public:
@@ -43,15 +45,17 @@ class FixedIntervalRateModule : public Module {
 		}
 
 	private:
-		RequestingPort<std::shared_ptr<Packet>> input_port_lr;
-		SendingPort<std::shared_ptr<Packet>> output_port_lr;
-		RequestingPort<std::shared_ptr<Packet>> input_port_rl;
-		SendingPort<std::shared_ptr<Packet>> output_port_rl;
+		RequestingPort<PacketRef> input_port_lr;
+		SendingPort<PacketRef> output_port_lr;
+		RequestingPort<PacketRef> input_port_rl;
+		SendingPort<PacketRef> output_port_rl;
 
 		ParameterDouble parameter_interval = {1, 0, std::numeric_limits<double>::quiet_NaN(), 1};
 		ParameterDouble parameter_rate = {1000, 0, std::numeric_limits<double>::quiet_NaN(), 1};
 
-		boost::asio::high_resolution_timer timer;
+		std::vector<PacketRef> batch;
+
+		WheelTimer timer;
 		void process(const boost::system::error_code& error);
 };
 
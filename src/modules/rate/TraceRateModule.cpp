@@ -135,12 +135,22 @@ void TraceRateModule::processLr(const boost::system::error_code& error) {
 		return;
 	}
 
-	auto packet = input_port_lr.request();
-	if(packet != nullptr) {
-		output_port_lr.send(packet);
+	// Delivery opportunities that are due by now, e.g. because they share
+	// the same millisecond, are used at once
+	unique_lock<mutex> trace_lr_lock(trace_lr_mutex);
+	const auto now = chrono::high_resolution_clock::now();
+	size_t opportunities = 1;
+	while(trace_lr_itr != trace_lr.end() && trace_start + chrono::milliseconds(*trace_lr_itr) <= now) {
+		trace_lr_itr++;
+		opportunities++;
 	}
+	trace_lr_lock.unlock();
 
-	unique_lock<mutex> trace_lr_lock(trace_lr_mutex);
+	input_port_lr.requestBatch(batch_lr, opportunities);
+	output_port_lr.send(Span<PacketRef>(batch_lr));
+	batch_lr.clear();
+
+	trace_lr_lock.lock();
 
 	if(trace_lr_itr == trace_lr.end()) {
 		if(trace_lr.back() >= trace_rl.back()) {
@@ -161,12 +171,22 @@ void TraceRateModule::processRl(const boost::system::error_code& error) {
 		return;
 	}
 
-	auto packet = input_port_rl.request();
-	if(packet != nullptr) {
-		output_port_rl.send(packet);
+	// Delivery opportunities that are due by now, e.g. because they share
+	// the same millisecond, are used at once
+	unique_lock<mutex> trace_rl_lock(trace_rl_mutex);
+	const auto now = chrono::high_resolution_clock::now();
+	size_t opportunities = 1;
+	while(trace_rl_itr != trace_rl.end() && trace_start + chrono::milliseconds(*trace_rl_itr) <= now) {
+		trace_rl_itr++;
+		opportunities++;
 	}
+	trace_rl_lock.unlock();
 
-	unique_lock<mutex> trace_rl_lock(trace_rl_mutex);
+	input_port_rl.requestBatch(batch_rl, opportunities);
+	output_port_rl.send(Span<PacketRef>(batch_rl));
+	batch_rl.clear();
+
+	trace_rl_lock.lock();
 
 	if(trace_rl_itr == trace_rl.end()) {
 		if(trace_rl.back() > trace_lr.back()) {
@@ -32,6 +32,7 @@
 
 #include "../Module.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class TraceRateModule : public Module {
 	public:
@@ -46,10 +47,10 @@ class TraceRateModule : public Module {
 		void reset();
 
 	private:
-		RequestingPort<std::shared_ptr<Packet>> input_port_lr;
-		SendingPort<std::shared_ptr<Packet>> output_port_lr;
-		RequestingPort<std::shared_ptr<Packet>> input_port_rl;
-		SendingPort<std::shared_ptr<Packet>> output_port_rl;
+		RequestingPort<PacketRef> input_port_lr;
+		SendingPort<PacketRef> output_port_lr;
+		RequestingPort<PacketRef> input_port_rl;
+		SendingPort<PacketRef> output_port_rl;
 
 		ParameterStringSelect parameter_trace_filename_lr = {"", {}};
 		ParameterStringSelect parameter_trace_filename_rl = {"", {}};
@@ -59,13 +60,15 @@ class TraceRateModule : public Module {
 		std::vector<uint32_t> trace_lr;
 		std::vector<uint32_t>::iterator trace_lr_itr;
 		std::mutex trace_lr_mutex;
-		boost::asio::high_resolution_timer timer_lr;
+		std::vector<PacketRef> batch_lr;
+		WheelTimer timer_lr;
 		void processLr(const boost::system::error_code& error);
 
 		std::vector<uint32_t> trace_rl;
 		std::vector<uint32_t>::iterator trace_rl_itr;
 		std::mutex trace_rl_mutex;
-		boost::asio::high_resolution_timer timer_rl;
+		std::vector<PacketRef> batch_rl;
+		WheelTimer timer_rl;
 		void processRl(const boost::system::error_code& error);
 
 		void listTraces(const std::string &path);
@@ -0,0 +1,231 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: https://docs.oasis-open.org/virtio/virtio/v1.1/csprd01/virtio-v1.1-csprd01.html#x1-2050006
+
+#include "SegmentationModule.hpp"
+
+#include <algorithm>
+
+#include "../../utils/VirtioNet.hpp"
+
+using namespace std;
+
+// Not defined by older kernel headers
+#ifndef VIRTIO_NET_HDR_GSO_UDP_L4
+#define VIRTIO_NET_HDR_GSO_UDP_L4 5
+#endif
+
+static constexpr uint8_t protocol_tcp = 6;
+static constexpr uint8_t protocol_udp = 17;
+
+// Ones' complement sum over 16 bit words in network byte order
+static uint32_t sum(const uint8_t *data, size_t size, uint32_t checksum = 0) {
+	for(size_t i = 0; i + 1 < size; i += 2) {
+		checksum += (data[i] << 8) | data[i+1];
+	}
+	if(size & 1) {
+		checksum += data[size-1] << 8;
+	}
+
+	return checksum;
+}
+
+static uint16_t fold(uint32_t checksum) {
+	while(checksum & 0xFFFF0000) {
+		checksum = (checksum & 0xFFFF) + (checksum >> 16);
+	}
+
+	return checksum;
+}
+
+SegmentationModule::SegmentationModule(boost::asio::io_service &io_service) {
+	setName("Segmentation");
+	setReplicable(true);
+	addPort({"in", "In", PortInfo::Side::left, &input_port});
+	addPort({"out", "Out", PortInfo::Side::right, &output_port});
+	addParameter({"mtu", "MTU", "bytes", &parameter_mtu});
+
+	input_port.setReceiveHandler<&SegmentationModule::receive>(this);
+}
+
+void SegmentationModule::receive(PacketRef packet) {
+	const virtio_net_hdr vnet_header = getVirtioNetHeader(*packet);
+	const uint8_t gso_type = vnet_header.gso_type & ~VIRTIO_NET_HDR_GSO_ECN;
+
+	// Network layer headers include IPv6 extension headers
+	const Packet::Headers &headers = packet->getHeaders();
+	const size_t network_layer_offset = headers.network_layer_offset;
+	const auto &bytes = packet->getBytes();
+	const size_t mtu = parameter_mtu.get();
+
+	const bool ipv4 = (headers.ip_version == 4);
+	const uint8_t protocol = headers.protocol;
+	size_t network_header_length = 0;
+	if(headers.ip_version != 0 && headers.transport_layer_offset != 0 && !headers.fragment) {
+		network_header_length = headers.transport_layer_offset - network_layer_offset;
+	}
+
+	// Parse transport layer
+	const size_t transport_layer_offset = network_layer_offset + network_header_length;
+	size_t transport_header_length = 0;
+	if(protocol == protocol_tcp && bytes.size() >= transport_layer_offset + 20) {
+		transport_header_length = (bytes[transport_layer_offset+12] >> 4) * 4;
+	} else if(protocol == protocol_udp && gso_type == VIRTIO_NET_HDR_GSO_UDP_L4) {
+		transport_header_length = 8;
+	}
+
+	// Headers that leave no room for payload in the MTU cannot be segmented
+	const size_t headers_length = transport_layer_offset + transport_header_length;
+	if(network_header_length == 0 || transport_header_length == 0 || bytes.size() <= headers_length ||
+	   bytes.size() - network_layer_offset <= mtu || network_header_length + transport_header_length >= mtu) {
+		// Nothing to segment
+		if(vnet_header.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+			vector<uint8_t> packet_bytes(bytes.begin(), bytes.end());
+			completeChecksum(packet_bytes, vnet_header.csum_start, vnet_header.csum_offset);
+			forward(packet, move(packet_bytes));
+			return;
+		}
+
+		output_port.send(move(packet));
+		return;
+	}
+
+	// Segment size is given by the sender or derived from the MTU, for
+	// example for packets that have been merged by GRO
+	size_t segment_size = mtu - network_header_length - transport_header_length;
+	if(vnet_header.gso_size != 0) {
+		segment_size = min(segment_size, (size_t) vnet_header.gso_size);
+	}
+
+	const size_t payload_length = bytes.size() - headers_length;
+	const uint32_t sequence_number = (bytes[transport_layer_offset+4] << 24) | (bytes[transport_layer_offset+5] << 16) | (bytes[transport_layer_offset+6] << 8) | bytes[transport_layer_offset+7];
+	const uint16_t identification = (bytes[network_layer_offset+4] << 8) | bytes[network_layer_offset+5];
+
+	for(size_t offset = 0; offset < payload_length; offset += segment_size) {
+		const size_t segment_payload_length = min(segment_size, payload_length - offset);
+		const bool first = (offset == 0);
+		const bool last = (offset + segment_payload_length == payload_length);
+
+		vector<uint8_t> segment_bytes;
+		segment_bytes.reserve(headers_length + segment_payload_length);
+		segment_bytes.insert(segment_bytes.end(), bytes.begin(), bytes.begin() + headers_length);
+		segment_bytes.insert(segment_bytes.end(), bytes.begin() + headers_length + offset, bytes.begin() + headers_length + offset + segment_payload_length);
+
+		// Update network layer header
+		if(ipv4) {
+			const uint16_t total_length = network_header_length + transport_header_length + segment_payload_length;
+			segment_bytes[network_layer_offset+2] = total_length >> 8;
+			segment_bytes[network_layer_offset+3] = total_length;
+
+			const uint16_t segment_identification = identification + offset / segment_size;
+			segment_bytes[network_layer_offset+4] = segment_identification >> 8;
+			segment_bytes[network_layer_offset+5] = segment_identification;
+		} else {
+			const uint16_t ipv6_payload_length = network_header_length - 40 + transport_header_length + segment_payload_length;
+			segment_bytes[network_layer_offset+4] = ipv6_payload_length >> 8;
+			segment_bytes[network_layer_offset+5] = ipv6_payload_length;
+		}
+
+		// Update transport layer header
+		if(protocol == protocol_tcp) {
+			const uint32_t segment_sequence_number = sequence_number + offset;
+			segment_bytes[transport_layer_offset+4] = segment_sequence_number >> 24;
+			segment_bytes[transport_layer_offset+5] = segment_sequence_number >> 16;
+			segment_bytes[transport_layer_offset+6] = segment_sequence_number >> 8;
+			segment_bytes[transport_layer_offset+7] = segment_sequence_number;
+
+			// CWR is only set on the first segment, FIN and PSH only on the last
+			if(!first) {
+				segment_bytes[transport_layer_offset+13] &= ~0x80;
+			}
+			if(!last) {
+				segment_bytes[transport_layer_offset+13] &= ~0x09;
+			}
+		} else {
+			const uint16_t length = transport_header_length + segment_payload_length;
+			segment_bytes[transport_layer_offset+4] = length >> 8;
+			segment_bytes[transport_layer_offset+5] = length;
+		}
+
+		updateTransportChecksum(segment_bytes, network_layer_offset, transport_layer_offset, ipv4, protocol);
+
+		forward(packet, move(segment_bytes));
+	}
+}
+
+void SegmentationModule::forward(const PacketRef &original_packet, vector<uint8_t> &&bytes) {
+	auto packet = Packet::create(bytes);
+	packet->setCreationTimePoint(original_packet->getCreationTimePoint());
+	packet->setIngressTimePoint(original_packet->getIngressTimePoint());
+	if(original_packet->hasDepartureTimePoint()) {
+		packet->setDepartureTimePoint(original_packet->getDepartureTimePoint());
+	}
+	packet->getAnnotations() = original_packet->getAnnotations();
+
+	// IPv4 header checksum has to be updated after the total length or
+	// identification has changed
+	packet->updateIPv4HeaderChecksum();
+
+	output_port.send(move(packet));
+}
+
+void SegmentationModule::completeChecksum(vector<uint8_t> &bytes, size_t checksum_start, size_t checksum_offset) {
+	// The checksum field already contains the sum of the pseudo header, so
+	// summing up everything from the start offset gives the final checksum
+	const size_t checksum_position = checksum_start + checksum_offset;
+	if(checksum_position + 2 > bytes.size()) {
+		return;
+	}
+
+	const uint16_t checksum = ~fold(sum(bytes.data() + checksum_start, bytes.size() - checksum_start));
+	bytes[checksum_position] = checksum >> 8;
+	bytes[checksum_position+1] = checksum;
+}
+
+void SegmentationModule::updateTransportChecksum(vector<uint8_t> &bytes, size_t network_layer_offset, size_t transport_layer_offset, bool ipv4, uint8_t protocol) {
+	const size_t checksum_offset = transport_layer_offset + ((protocol == protocol_tcp) ? 16 : 6);
+	bytes[checksum_offset] = 0;
+	bytes[checksum_offset+1] = 0;
+
+	// Sum up pseudo header
+	const size_t transport_length = bytes.size() - transport_layer_offset;
+	uint32_t checksum = 0;
+	if(ipv4) {
+		checksum = sum(bytes.data() + network_layer_offset + 12, 8);
+	} else {
+		checksum = sum(bytes.data() + network_layer_offset + 8, 32);
+	}
+	checksum += protocol;
+	checksum += transport_length >> 16;
+	checksum += transport_length & 0xFFFF;
+
+	// Sum up transport layer header and payload
+	checksum = sum(bytes.data() + transport_layer_offset, transport_length, checksum);
+
+	uint16_t result = ~fold(checksum);
+	if(protocol == protocol_udp && result == 0) {
+		result = 0xFFFF;
+	}
+
+	bytes[checksum_offset] = result >> 8;
+	bytes[checksum_offset+1] = result;
+}
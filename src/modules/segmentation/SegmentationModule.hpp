@@ -0,0 +1,58 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEGMENTATION_MODULE_HPP
+#define SEGMENTATION_MODULE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "../Module.hpp"
+#include "../../utils/Packet.hpp"
+
+// Splits GSO/GRO super-packets into packets that fit into the MTU and
+// completes partial checksums, so that the following modules see the
+// packets as they would appear on the wire
+class SegmentationModule : public Module {
+	public:
+		SegmentationModule(boost::asio::io_service &io_service);
+
+		const char* getType() const {
+			return "segmentation";
+		}
+
+	private:
+		ReceivingPort<PacketRef> input_port;
+		SendingPort<PacketRef> output_port;
+
+		ParameterDouble parameter_mtu = {1500, 576, 65535, 1};
+
+		void receive(PacketRef packet);
+
+		void forward(const PacketRef &original_packet, std::vector<uint8_t> &&bytes);
+		static void completeChecksum(std::vector<uint8_t> &bytes, size_t checksum_start, size_t checksum_offset);
+		static void updateTransportChecksum(std::vector<uint8_t> &bytes, size_t network_layer_offset, size_t transport_layer_offset, bool ipv4, uint8_t protocol);
+};
+
+#endif
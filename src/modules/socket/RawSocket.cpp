@@ -24,22 +24,239 @@
 
 #include "RawSocket.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#include <unistd.h>
+#include <linux/net_tstamp.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
 #include <boost/bind.hpp>
 
 using namespace std;
 
-RawSocket::RawSocket(boost::asio::io_service& io_service, std::string ifname, PortInfo::Side ports_side) : socket(io_service, boost::asio::generic::raw_protocol(PF_PACKET, SOCK_RAW)) {
+// Minimum time between handing a frame to the kernel and its departure
+static constexpr chrono::microseconds tx_time_lead(50);
+
+// Frames are only held back until their departure time by an ETF qdisc, any
+// other qdisc sends them right away
+static bool hasEtfQdisc(int ifindex) {
+	const int fd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if(fd < 0) {
+		return false;
+	}
+
+	struct {
+		nlmsghdr header;
+		tcmsg message;
+	} request;
+	memset(&request, 0, sizeof(request));
+	request.header.nlmsg_len = sizeof(request);
+	request.header.nlmsg_type = RTM_GETQDISC;
+	request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	request.message.tcm_family = AF_UNSPEC;
+	if(::send(fd, &request, sizeof(request), 0) < 0) {
+		::close(fd);
+		return false;
+	}
+
+	// The dump covers the qdiscs of all interfaces
+	bool found = false;
+	bool done = false;
+	alignas(nlmsghdr) uint8_t buffer[32768];
+	while(!done) {
+		int length = recv(fd, buffer, sizeof(buffer), 0);
+		if(length <= 0) {
+			break;
+		}
+
+		for(nlmsghdr *header = reinterpret_cast<nlmsghdr*>(buffer); NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+			if(header->nlmsg_type == NLMSG_DONE || header->nlmsg_type == NLMSG_ERROR) {
+				done = true;
+				break;
+			}
+
+			const tcmsg *message = static_cast<const tcmsg*>(NLMSG_DATA(header));
+			if(header->nlmsg_type != RTM_NEWQDISC || message->tcm_ifindex != ifindex) {
+				continue;
+			}
+
+			int attributes_length = header->nlmsg_len - NLMSG_LENGTH(sizeof(*message));
+			for(const rtattr *attribute = reinterpret_cast<const rtattr*>(reinterpret_cast<const uint8_t*>(message) + NLMSG_ALIGN(sizeof(*message))); RTA_OK(attribute, attributes_length); attribute = RTA_NEXT(attribute, attributes_length)) {
+				if(attribute->rta_type == TCA_KIND && strcmp(static_cast<const char*>(RTA_DATA(attribute)), "etf") == 0) {
+					found = true;
+				}
+			}
+		}
+	}
+
+	::close(fd);
+
+	return found;
+}
+
+RawSocket::RawSocket(boost::asio::io_service& io_service, std::string ifname, PortInfo::Side ports_side, bool fanout) : io_service(io_service), ifname(ifname), fanout(fanout), socket(io_service), timer_rx_ring_hold(io_service), timer_statistics(io_service) {
 	setName("Raw Socket");
+	setReplicable(true);
+
+	// A socket with its ports on the right is at the left edge of the graph
+	ingress_side = (ports_side == PortInfo::Side::right) ? Packet::Annotations::Side::left : Packet::Annotations::Side::right;
 	switch(ports_side) {
 		case PortInfo::Side::left:
 			addPort({"in", "In", PortInfo::Side::left, &input_port});
 			addPort({"out", "Out", PortInfo::Side::left, &output_port});
+			addPort({"bypass", "Bypass", PortInfo::Side::left, &bypass_port});
 			break;
 		case PortInfo::Side::right:
 			addPort({"out", "Out", PortInfo::Side::right, &output_port});
 			addPort({"in", "In", PortInfo::Side::right, &input_port});
+			addPort({"bypass", "Bypass", PortInfo::Side::right, &bypass_port});
 			break;
 	}
+	addParameter({"filter", "Filter", "", &parameter_filter});
+	addParameter({"filter_mode", "Filter Mode", "", &parameter_filter_mode});
+	addParameter({"rx_mode", "RX Mode", "", &parameter_rx_mode});
+	addParameter({"rx_ring_block_size", "RX Ring Block Size", "KiB", &parameter_rx_ring_block_size});
+	addParameter({"rx_ring_blocks", "RX Ring Blocks", "", &parameter_rx_ring_blocks});
+	addParameter({"rx_ring_block_timeout", "RX Ring Block Timeout", "ms", &parameter_rx_ring_block_timeout});
+	addParameter({"rx_ring_hold_time", "RX Ring Hold Time", "ms", &parameter_rx_ring_hold_time});
+	addParameter({"tx_mode", "TX Mode", "", &parameter_tx_mode});
+	addParameter({"tx_ring_frames", "TX Ring Frames", "", &parameter_tx_ring_frames});
+	addParameter({"tx_queue_size", "TX Queue", "packets", &parameter_tx_queue_size});
+	addParameter({"tx_qdisc_bypass", "TX Qdisc Bypass", "", &parameter_tx_qdisc_bypass});
+	addParameter({"busy_poll", "Busy Poll", "µs", &parameter_busy_poll});
+	addParameter({"rx_timestamps", "RX Timestamps", "", &parameter_rx_timestamps});
+	addParameter({"tx_time", "TX Time", "", &parameter_tx_time});
+	addParameter({"gso", "GSO", "", &parameter_gso});
+	addStatistic({"rx_packets", "Packets Received", "", &statistic_rx_packets});
+	addStatistic({"rx_drops", "Packets Dropped by Kernel", "", &statistic_rx_drops});
+	addStatistic({"rx_freezes", "RX Ring Freezes", "", &statistic_rx_freezes});
+	addStatistic({"tx_packets", "Packets Sent", "", &statistic_tx_packets});
+	addStatistic({"tx_deferred", "Packets Deferred", "", &statistic_tx_deferred});
+	addStatistic({"tx_dropped", "Packets Dropped", "", &statistic_tx_dropped});
+	addStatistic({"tx_queue_length", "TX Queue", "packets", &statistic_tx_queue_length});
+
+	input_port.setReceiveHandler<&RawSocket::send>(this);
+
+	if(boost::asio::has_service<IoUring>(io_service) && boost::asio::use_service<IoUring>(io_service).isReady()) {
+		io_uring = &boost::asio::use_service<IoUring>(io_service);
+	}
+
+	open();
+
+	parameter_filter.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_filter_mode.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_rx_mode.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_rx_ring_block_size.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_rx_ring_blocks.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_rx_ring_block_timeout.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_rx_ring_hold_time.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_tx_mode.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_tx_ring_frames.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_tx_qdisc_bypass.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_busy_poll.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_rx_timestamps.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_tx_time.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+	parameter_gso.addChangeHandler(bind(&RawSocket::scheduleReopen, this));
+
+	// Start statistics timer
+	timer_statistics.expires_from_now(chrono::milliseconds(0));
+	timer_statistics.async_wait(boost::bind(&RawSocket::statistics, this, boost::asio::placeholders::error));
+}
+
+void RawSocket::open() {
+	socket.open(boost::asio::generic::raw_protocol(PF_PACKET, SOCK_RAW));
+
+	// The rings have to be configured before binding, so that no frame is
+	// delivered to the regular receive queue in between
+	const string rx_mode = parameter_rx_mode.get();
+	const string tx_mode_name = parameter_tx_mode.get();
+
+	// GSO frames are passed on as is together with their virtio-net header,
+	// which is not supported by the rings
+	vnet_hdr = false;
+	if(parameter_gso.get()) {
+		int value = 1;
+		if(setsockopt(socket.native_handle(), SOL_PACKET, PACKET_VNET_HDR, &value, sizeof(value)) < 0) {
+			cerr << "Cannot enable virtio-net headers on " << ifname << ": " << strerror(errno) << "!" << endl;
+		} else {
+			vnet_hdr = true;
+		}
+	}
+
+	if(!vnet_hdr && (rx_mode == "ring" || tx_mode_name == "ring")) {
+		setupRings(rx_mode == "ring", tx_mode_name == "ring");
+	}
+
+	// Only sendmmsg can attach a departure time to every frame. io_uring
+	// takes the place of send, the other modes are kept as configured.
+	if(parameter_tx_time.get()) {
+		tx_mode = TxMode::sendmmsg;
+	} else if(tx_mode_name == "ring" && !tx_ring_frames.empty()) {
+		tx_mode = TxMode::ring;
+	} else if(tx_mode_name == "sendmmsg") {
+		tx_mode = TxMode::sendmmsg;
+	} else if(io_uring != nullptr && !vnet_hdr) {
+		tx_mode = TxMode::uring;
+	} else {
+		tx_mode = TxMode::send;
+	}
+
+	if(io_uring != nullptr && tx_mode != TxMode::uring) {
+		cerr << "Not using io_uring to transmit on " << ifname << ", as " << (parameter_tx_time.get() ? "TX time" : vnet_hdr ? "GSO" : "TX mode " + tx_mode_name) << " is configured!" << endl;
+	}
+
+	if(parameter_tx_qdisc_bypass.get()) {
+		int value = 1;
+		if(setsockopt(socket.native_handle(), SOL_PACKET, PACKET_QDISC_BYPASS, &value, sizeof(value)) < 0) {
+			cerr << "Cannot enable qdisc bypass on " << ifname << ": " << strerror(errno) << "!" << endl;
+		}
+	}
+
+	if(parameter_busy_poll.get() > 0) {
+		const int busy_poll = parameter_busy_poll.get();
+		const int prefer_busy_poll = 1;
+		const int busy_poll_budget = 64;
+		if(setsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)) < 0 ||
+		   setsockopt(socket.native_handle(), SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer_busy_poll, sizeof(prefer_busy_poll)) < 0 ||
+		   setsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL_BUDGET, &busy_poll_budget, sizeof(busy_poll_budget)) < 0) {
+			cerr << "Cannot enable busy polling on " << ifname << ": " << strerror(errno) << "!" << endl;
+		}
+	}
+
+	// The filter is attached before binding, so that no frame passes
+	// unfiltered in between
+	attachFilter();
+
+	// Frames with a departure time are held back by an ETF qdisc on the
+	// interface, which has to use the same clock
+	if(parameter_tx_time.get()) {
+		sock_txtime txtime;
+		memset(&txtime, 0, sizeof(txtime));
+		txtime.clockid = CLOCK_TAI;
+		if(setsockopt(socket.native_handle(), SOL_SOCKET, SO_TXTIME, &txtime, sizeof(txtime)) < 0) {
+			cerr << "Cannot enable TX time on " << ifname << ": " << strerror(errno) << "!" << endl;
+		} else if(!hasEtfQdisc(if_nametoindex(ifname.c_str()))) {
+			cerr << "No ETF qdisc on " << ifname << ", packets are held back by the modules until their departure time!" << endl;
+		} else {
+			// Modules connected to the socket may hand packets over ahead
+			// of time from now on
+			input_port.setReleasesAtDepartureTime(true);
+		}
+	}
+
+	// Timestamps are taken when the frame enters the network stack, which
+	// also applies to the RX ring
+	if(parameter_rx_timestamps.get()) {
+		int value = 1;
+		if(setsockopt(socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &value, sizeof(value)) < 0) {
+			cerr << "Cannot enable timestamps on " << ifname << ": " << strerror(errno) << "!" << endl;
+		}
+	}
 
 	sockaddr_ll sockaddr;
 	memset(&sockaddr, 0, sizeof(sockaddr));
@@ -50,16 +267,407 @@ RawSocket::RawSocket(boost::asio::io_service& io_service, std::string ifname, Po
 
 	socket.bind(boost::asio::generic::basic_endpoint<boost::asio::generic::raw_protocol>(&sockaddr, sizeof(sockaddr)));
 
-	input_port.setReceiveHandler(bind(&RawSocket::send, this, placeholders::_1));
+	// All sockets of an interface join the same group, which keeps the
+	// frames of a flow (including fragments) on the same socket
+	if(fanout) {
+		const int fanout_arg = (sockaddr.sll_ifindex & 0xffff) | ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16);
+		if(setsockopt(socket.native_handle(), SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) < 0) {
+			cerr << "Cannot join fanout group of " << ifname << ": " << strerror(errno) << "!" << endl;
+		}
+	}
 
-	startReceive();
+	if(!rx_ring_blocks.empty()) {
+		startReceiveRing();
+	} else if(parameter_rx_timestamps.get()) {
+		startReceiveTimestamped();
+	} else if(io_uring != nullptr && (io_uring_buffer_group = io_uring->addBufferGroup(128, recv_buffer.size())) >= 0) {
+		startReceiveUring();
+	} else {
+		startReceive();
+	}
+
+	// Frames might have been left over from before a reconfiguration
+	if(!tx_queue.empty()) {
+		scheduleFlush();
+	}
+}
+
+void RawSocket::close() {
+	// Kernel counters are reset on read, so collect them before they are lost
+	updateKernelStatistics();
+
+	if(io_uring != nullptr) {
+		io_uring->cancel(socket.native_handle());
+		io_uring->removeBufferGroup(io_uring_buffer_group);
+		io_uring_buffer_group = -1;
+		tx_inflight = 0;
+	}
+
+	// A pending wait for the socket to become writable is canceled, so the
+	// next open has to schedule a flush again
+	socket.cancel();
+	socket.close();
+	tx_flush_pending = false;
+	input_port.setReleasesAtDepartureTime(false);
+
+	timer_rx_ring_hold.cancel();
+	rx_ring_hold_pending = false;
+	teardownRings();
+}
+
+void RawSocket::scheduleReopen() {
+	// Parameters are changed from the MQTT thread, so the socket is
+	// reconfigured on the thread that runs the I/O service
+	if(reopen_pending.exchange(true)) {
+		return;
+	}
+
+	post(io_service, [this]() {
+		reopen_pending = false;
+
+		close();
+		open();
+	});
+}
+
+void RawSocket::send(PacketRef packet) {
+	if(tx_mode == TxMode::send && tx_queue.empty()) {
+		std::vector<boost::asio::const_buffer> send_buffers;
+		if(vnet_hdr) {
+			send_buffers.emplace_back(packet->getVnetHeader().data(), Packet::vnet_header_size);
+		}
+		const auto &packet_bytes = packet->getBytes();
+		send_buffers.emplace_back(packet_bytes.data(), packet_bytes.size());
+
+		// Frames can be rejected, e.g. GSO frames without virtio-net header
+		boost::system::error_code error;
+		socket.send(send_buffers, 0, error);
+		if(error) {
+			tx_dropped++;
+			return;
+		}
+		tx_packets++;
+		return;
+	}
+
+	if(tx_queue.size() + tx_inflight >= parameter_tx_queue_size.get()) {
+		tx_dropped++;
+		return;
+	}
+
+	// Collect frames until the current event loop turn is over
+	tx_queue.emplace_back(packet);
+	scheduleFlush();
+}
+
+void RawSocket::scheduleFlush() {
+	if(tx_flush_pending) {
+		return;
+	}
+	tx_flush_pending = true;
+
+	post(io_service, bind(&RawSocket::flush, this));
 }
 
-void RawSocket::send(shared_ptr<Packet> packet) {
-	std::vector<boost::asio::const_buffer> send_buffers;
-	const auto &packet_bytes = packet->getBytes();
-	send_buffers.emplace_back(packet_bytes.data(), packet_bytes.size());
-	socket.send(send_buffers);
+void RawSocket::flush() {
+	tx_flush_pending = false;
+
+	if(!socket.is_open()) {
+		return;
+	}
+
+	if(tx_mode == TxMode::ring) {
+		flushRing();
+	} else if(tx_mode == TxMode::uring) {
+		flushUring();
+	} else {
+		flushSendmmsg();
+	}
+}
+
+void RawSocket::flushSendmmsg() {
+	constexpr size_t batch_size = 64;
+	mmsghdr msgs[batch_size];
+	iovec iovecs[batch_size][2];
+	alignas(cmsghdr) uint8_t controls[batch_size][CMSG_SPACE(sizeof(uint64_t))];
+
+	// Departure times are given in CLOCK_REALTIME, but the socket uses
+	// CLOCK_TAI, so the offset between both is added
+	const bool tx_time = parameter_tx_time.get();
+	int64_t tai_offset = 0;
+	chrono::high_resolution_clock::time_point earliest_departure_time_point;
+	if(tx_time) {
+		timespec realtime, tai;
+		clock_gettime(CLOCK_REALTIME, &realtime);
+		clock_gettime(CLOCK_TAI, &tai);
+		tai_offset = (tai.tv_sec - realtime.tv_sec) * 1000000000LL + (tai.tv_nsec - realtime.tv_nsec);
+		tai_offset = (tai_offset + 500000000LL) / 1000000000LL * 1000000000LL;
+
+		// The qdisc drops frames whose departure time has passed, e.g.
+		// frames that have been held back by a module before being
+		// stamped, so these are given a departure time shortly ahead
+		// instead
+		earliest_departure_time_point = chrono::high_resolution_clock::now() + tx_time_lead;
+	}
+
+	while(!tx_queue.empty()) {
+		const size_t batch_length = min(batch_size, tx_queue.size());
+		for(size_t i = 0; i < batch_length; ++i) {
+			memset(&msgs[i], 0, sizeof(msgs[i]));
+			msgs[i].msg_hdr.msg_iov = iovecs[i];
+
+			if(vnet_hdr) {
+				iovecs[i][msgs[i].msg_hdr.msg_iovlen].iov_base = const_cast<uint8_t*>(tx_queue[i]->getVnetHeader().data());
+				iovecs[i][msgs[i].msg_hdr.msg_iovlen].iov_len = Packet::vnet_header_size;
+				msgs[i].msg_hdr.msg_iovlen++;
+			}
+
+			const auto &packet_bytes = tx_queue[i]->getBytes();
+			iovecs[i][msgs[i].msg_hdr.msg_iovlen].iov_base = const_cast<uint8_t*>(packet_bytes.data());
+			iovecs[i][msgs[i].msg_hdr.msg_iovlen].iov_len = packet_bytes.size();
+			msgs[i].msg_hdr.msg_iovlen++;
+
+			// Frames without departure time would be dropped by the qdisc
+			// as well, so all frames are given one
+			if(tx_time) {
+				const auto departure_time_point = tx_queue[i]->hasDepartureTimePoint() ? max(tx_queue[i]->getDepartureTimePoint(), earliest_departure_time_point) : earliest_departure_time_point;
+				const uint64_t txtime = chrono::duration_cast<chrono::nanoseconds>(departure_time_point.time_since_epoch()).count() + tai_offset;
+
+				msgs[i].msg_hdr.msg_control = controls[i];
+				msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+				cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+				cmsg->cmsg_level = SOL_SOCKET;
+				cmsg->cmsg_type = SCM_TXTIME;
+				cmsg->cmsg_len = CMSG_LEN(sizeof(txtime));
+				memcpy(CMSG_DATA(cmsg), &txtime, sizeof(txtime));
+			}
+		}
+
+		const int sent = sendmmsg(socket.native_handle(), msgs, batch_length, MSG_DONTWAIT);
+		if(sent < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			if(errno == EAGAIN || errno == EWOULDBLOCK) {
+				deferFlush();
+				return;
+			}
+
+			// The first frame has been rejected (e.g. too long or dropped
+			// by the qdisc), so discard it and go on with the rest
+			tx_dropped++;
+			popTxQueue(1);
+			continue;
+		}
+
+		tx_packets += sent;
+		popTxQueue(sent);
+	}
+}
+
+void RawSocket::flushRing() {
+	const size_t data_offset = TPACKET3_HDRLEN - sizeof(sockaddr_ll);
+	const size_t data_size_max = tx_ring_req.tp_frame_size - data_offset;
+
+	bool frames_queued = false;
+	while(!tx_queue.empty()) {
+		tpacket3_hdr *frame = tx_ring_frames[tx_ring_frame_index];
+		if(__atomic_load_n(&frame->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE) {
+			// Ring is full
+			break;
+		}
+
+		const auto &packet_bytes = tx_queue.front()->getBytes();
+		if(packet_bytes.size() > data_size_max) {
+			tx_dropped++;
+			popTxQueue(1);
+			continue;
+		}
+
+		memcpy(reinterpret_cast<uint8_t*>(frame) + data_offset, packet_bytes.data(), packet_bytes.size());
+		frame->tp_len = packet_bytes.size();
+		frame->tp_snaplen = packet_bytes.size();
+		frame->tp_next_offset = 0;
+		__atomic_store_n(&frame->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+		tx_ring_frame_index = (tx_ring_frame_index + 1) % tx_ring_frames.size();
+		tx_packets++;
+		popTxQueue(1);
+		frames_queued = true;
+	}
+
+	// Kick the kernel once for all frames of this turn
+	if(frames_queued) {
+		if(::send(socket.native_handle(), nullptr, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+			cerr << "Cannot transmit TX ring of " << ifname << ": " << strerror(errno) << "!" << endl;
+		}
+	}
+
+	if(!tx_queue.empty()) {
+		deferFlush();
+	}
+}
+
+void RawSocket::flushUring() {
+	// A send that finds the socket busy is retried by the kernel later on,
+	// so the sends are linked and only one chain is in flight at a time to
+	// keep the frames in order. The next chain is started by the completion
+	// of the last send.
+	if(tx_inflight > 0) {
+		return;
+	}
+
+	constexpr size_t batch_size = 64;
+	const size_t batch_length = min({batch_size, tx_queue.size(), (size_t) io_uring->getSubmissionSpace()});
+	if(batch_length == 0) {
+		// Submission queue is full, try again in the next turn
+		if(!tx_queue.empty()) {
+			scheduleFlush();
+		}
+		return;
+	}
+
+	// All frames of this turn are handed to the kernel with one submission
+	for(size_t i = 0; i < batch_length; ++i) {
+		// The kernel might read the data after an RX ring block has been
+		// handed back
+		const auto &packet = tx_queue.front();
+		packet->detachBytes();
+		const auto &packet_bytes = packet->getBytes();
+		io_uring->send(socket.native_handle(), packet_bytes.data(), packet_bytes.size(), i + 1 < batch_length, [this, packet](int result, uint32_t flags) {
+			tx_inflight--;
+			if(result < 0) {
+				tx_dropped++;
+			} else {
+				tx_packets++;
+			}
+
+			if(tx_inflight == 0 && !tx_queue.empty()) {
+				scheduleFlush();
+			}
+		});
+
+		tx_inflight++;
+		popTxQueue(1);
+	}
+}
+
+void RawSocket::popTxQueue(size_t count) {
+	for(size_t i = 0; i < count; ++i) {
+		tx_queue.pop_front();
+	}
+
+	tx_queue_deferred = (tx_queue_deferred > count) ? tx_queue_deferred - count : 0;
+}
+
+void RawSocket::deferFlush() {
+	// Count every frame only once, even if it has to wait several times
+	tx_deferred += tx_queue.size() - tx_queue_deferred;
+	tx_queue_deferred = tx_queue.size();
+
+	tx_flush_pending = true;
+	socket.async_wait(boost::asio::socket_base::wait_write,
+	                  boost::bind(&RawSocket::handleWritable,
+	                              this,
+	                              boost::asio::placeholders::error
+	                  )
+	);
+}
+
+void RawSocket::handleWritable(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	flush();
+}
+
+void RawSocket::attachFilter() {
+	bypass_filter.reset();
+
+	const string expression = parameter_filter.get();
+	if(expression.empty()) {
+		return;
+	}
+
+	unique_ptr<BpfFilter> filter;
+	try {
+		filter = make_unique<BpfFilter>(expression);
+	} catch(const runtime_error &e) {
+		cerr << "Cannot compile filter for " << ifname << ": " << e.what() << "!" << endl;
+		return;
+	}
+
+	// Non-matching frames are either dropped by the kernel or received and
+	// forwarded to the bypass port without passing through the graph
+	if(parameter_filter_mode.get() == "bypass") {
+		bypass_filter = move(filter);
+		return;
+	}
+
+	sock_fprog fprog;
+	fprog.len = filter->getProgram().size();
+	fprog.filter = const_cast<sock_filter*>(filter->getProgram().data());
+	if(setsockopt(socket.native_handle(), SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0) {
+		cerr << "Cannot attach filter to " << ifname << ": " << strerror(errno) << "!" << endl;
+	}
+}
+
+PacketRef RawSocket::createPacket(const uint8_t *data, size_t size) {
+	if(!vnet_hdr) {
+		return Packet::create(data, size);
+	}
+
+	if(size < Packet::vnet_header_size) {
+		return nullptr;
+	}
+
+	// The header is passed on as is, its fields are not needed here
+	Packet::VnetHeader vnet_header;
+	memcpy(vnet_header.data(), data, vnet_header.size());
+
+	auto packet = Packet::create(data + vnet_header.size(), size - vnet_header.size());
+	packet->setVnetHeader(vnet_header);
+
+	return packet;
+}
+
+void RawSocket::deliver(PacketRef packet) {
+	if(packet == nullptr) {
+		return;
+	}
+
+	packet->getAnnotations().ingress_side = ingress_side;
+
+	if(bypass_filter != nullptr) {
+		const auto &packet_bytes = packet->getBytes();
+		if(!bypass_filter->match(packet_bytes.data(), packet_bytes.size())) {
+			bypass_port.send(move(packet));
+			return;
+		}
+	}
+
+	output_port.send(move(packet));
+}
+
+void RawSocket::deliver(Span<PacketRef> packets) {
+	size_t kept = 0;
+	for(auto &packet : packets) {
+		packet->getAnnotations().ingress_side = ingress_side;
+
+		if(bypass_filter != nullptr) {
+			const auto &packet_bytes = packet->getBytes();
+			if(!bypass_filter->match(packet_bytes.data(), packet_bytes.size())) {
+				bypass_port.send(move(packet));
+				continue;
+			}
+		}
+
+		packets[kept++] = move(packet);
+	}
+
+	output_port.send(packets.first(kept));
 }
 
 void RawSocket::startReceive() {
@@ -79,13 +687,399 @@ void RawSocket::handleReceive(const boost::system::error_code& error, size_t byt
 	}
 
 	if(!error || error == boost::asio::error::message_size) {
-		output_port.send(make_shared<Packet>(recv_buffer.data(), bytes_transferred));
+		deliver(createPacket(recv_buffer.data(), bytes_transferred));
+	}
+
+	startReceive();
+}
+
+void RawSocket::startReceiveTimestamped() {
+	socket.async_wait(boost::asio::socket_base::wait_read,
+	                  boost::bind(&RawSocket::handleReceiveTimestamped,
+	                              this,
+	                              boost::asio::placeholders::error
+	                  )
+	);
+}
+
+void RawSocket::handleReceiveTimestamped(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	// Drain a limited number of frames, so that other handlers are not starved
+	for(size_t i = 0; i < 64; ++i) {
+		iovec iov;
+		iov.iov_base = recv_buffer.data();
+		iov.iov_len = recv_buffer.size();
+
+		alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(timespec))];
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		const ssize_t length = recvmsg(socket.native_handle(), &msg, MSG_DONTWAIT);
+		if(length < 0) {
+			break;
+		}
+
+		auto packet = createPacket(recv_buffer.data(), length);
+		if(packet == nullptr) {
+			continue;
+		}
+		for(cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+				timespec timestamp;
+				memcpy(&timestamp, CMSG_DATA(cmsg), sizeof(timestamp));
+				packet->setIngressTimePoint(toTimePoint(timestamp.tv_sec, timestamp.tv_nsec));
+			}
+		}
+		deliver(packet);
+	}
+
+	startReceiveTimestamped();
+}
+
+chrono::high_resolution_clock::time_point RawSocket::toTimePoint(uint64_t sec, uint64_t nsec) {
+	// Kernel timestamps use CLOCK_REALTIME, which is the clock behind
+	// system_clock and thus high_resolution_clock with libstdc++
+	static_assert(is_same<chrono::high_resolution_clock, chrono::system_clock>::value, "high_resolution_clock has to be system_clock!");
+
+	return chrono::high_resolution_clock::time_point(chrono::duration_cast<chrono::high_resolution_clock::duration>(chrono::seconds(sec) + chrono::nanoseconds(nsec)));
+}
+
+void RawSocket::startReceiveUring() {
+	if(!io_uring->receiveMultishot(socket.native_handle(), io_uring_buffer_group, bind(&RawSocket::handleReceiveUring, this, placeholders::_1, placeholders::_2))) {
+		// Submission queue is full, try again in the next turn
+		post(io_service, bind(&RawSocket::startReceiveUring, this));
+	}
+}
+
+void RawSocket::handleReceiveUring(int result, uint32_t flags) {
+	if(result >= 0 && (flags & IORING_CQE_F_BUFFER)) {
+		const uint16_t buffer = flags >> IORING_CQE_BUFFER_SHIFT;
+		deliver(createPacket(io_uring->getBuffer(io_uring_buffer_group, buffer), result));
+		io_uring->recycleBuffer(io_uring_buffer_group, buffer);
+	}
+
+	if(flags & IORING_CQE_F_MORE) {
+		return;
+	}
+
+	// The receive ends when the kernel runs out of buffers, which are
+	// available again by now
+	if(result >= 0 || result == -ENOBUFS) {
+		startReceiveUring();
+		return;
 	}
 
+	cerr << "Cannot receive from " << ifname << " with io_uring: " << strerror(-result) << "! Falling back to recv." << endl;
+	io_uring->removeBufferGroup(io_uring_buffer_group);
+	io_uring_buffer_group = -1;
 	startReceive();
 }
 
+void RawSocket::setupRings(bool rx_ring_requested, bool tx_ring_requested) {
+	const int fd = socket.native_handle();
+
+	int version = TPACKET_V3;
+	if(setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+		cerr << "Cannot set TPACKET_V3 on " << ifname << ": " << strerror(errno) << "! Rings are disabled." << endl;
+		return;
+	}
+
+	// The kernel requires blocks to be a power-of-two multiple of the page size
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	// Frames are sized for jumbo frames, larger GSO frames still fit into
+	// the RX blocks
+	const size_t frame_data_size = 10000;
+	size_t frame_size = TPACKET_ALIGNMENT;
+	while(frame_size < TPACKET_ALIGN(TPACKET3_HDRLEN + frame_data_size)) {
+		frame_size <<= 1;
+	}
+
+	size_t rx_ring_size = 0;
+	if(rx_ring_requested) {
+		size_t block_size = page_size;
+		while(block_size < (size_t) parameter_rx_ring_block_size.get() * 1024 || block_size < frame_size) {
+			block_size <<= 1;
+		}
+		const size_t blocks = parameter_rx_ring_blocks.get();
+
+		memset(&rx_ring_req, 0, sizeof(rx_ring_req));
+		rx_ring_req.tp_block_size = block_size;
+		rx_ring_req.tp_block_nr = blocks;
+		rx_ring_req.tp_frame_size = frame_size;
+		rx_ring_req.tp_frame_nr = (block_size / frame_size) * blocks;
+		rx_ring_req.tp_retire_blk_tov = parameter_rx_ring_block_timeout.get();
+
+		if(setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &rx_ring_req, sizeof(rx_ring_req)) < 0) {
+			cerr << "Cannot set up RX ring on " << ifname << ": " << strerror(errno) << "! Falling back to recv mode." << endl;
+			memset(&rx_ring_req, 0, sizeof(rx_ring_req));
+		} else {
+			rx_ring_size = block_size * blocks;
+		}
+	}
+
+	size_t tx_ring_size = 0;
+	if(tx_ring_requested) {
+		const size_t frames = parameter_tx_ring_frames.get();
+		const size_t block_size = max(frame_size, page_size);
+
+		memset(&tx_ring_req, 0, sizeof(tx_ring_req));
+		tx_ring_req.tp_block_size = block_size;
+		tx_ring_req.tp_block_nr = frames / (block_size / frame_size);
+		tx_ring_req.tp_frame_size = frame_size;
+		tx_ring_req.tp_frame_nr = tx_ring_req.tp_block_nr * (block_size / frame_size);
+
+		// Skip malformed frames instead of stalling the ring
+		int loss = 1;
+		setsockopt(fd, SOL_PACKET, PACKET_LOSS, &loss, sizeof(loss));
+
+		if(setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &tx_ring_req, sizeof(tx_ring_req)) < 0) {
+			cerr << "Cannot set up TX ring on " << ifname << ": " << strerror(errno) << "! Falling back to send mode." << endl;
+			memset(&tx_ring_req, 0, sizeof(tx_ring_req));
+		} else {
+			tx_ring_size = block_size * tx_ring_req.tp_block_nr;
+		}
+	}
+
+	ring_size = rx_ring_size + tx_ring_size;
+	if(ring_size == 0) {
+		return;
+	}
+
+	void *mapping = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+	if(mapping == MAP_FAILED) {
+		cerr << "Cannot map rings of " << ifname << ": " << strerror(errno) << "! Rings are disabled." << endl;
+
+		// Release the rings again, otherwise the socket does not deliver any frames
+		memset(&rx_ring_req, 0, sizeof(rx_ring_req));
+		memset(&tx_ring_req, 0, sizeof(tx_ring_req));
+		setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &rx_ring_req, sizeof(rx_ring_req));
+		setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &tx_ring_req, sizeof(tx_ring_req));
+		ring_size = 0;
+		return;
+	}
+	ring = static_cast<uint8_t*>(mapping);
+
+	// The RX ring is always mapped in front of the TX ring
+	for(size_t i = 0; i < rx_ring_req.tp_block_nr; ++i) {
+		rx_ring_blocks.push_back(make_unique<RxRingBlock>());
+		rx_ring_blocks.back()->descriptor = reinterpret_cast<tpacket_block_desc*>(ring + i * rx_ring_req.tp_block_size);
+	}
+	rx_ring_block_index = 0;
+
+	for(size_t i = 0; i < tx_ring_req.tp_frame_nr; ++i) {
+		tx_ring_frames.push_back(reinterpret_cast<tpacket3_hdr*>(ring + rx_ring_size + i * tx_ring_req.tp_frame_size));
+	}
+	tx_ring_frame_index = 0;
+}
+
+void RawSocket::teardownRings() {
+	// Packets must not reference the ring after it has been unmapped
+	for(auto &block : rx_ring_blocks) {
+		block->detachAll();
+	}
+
+	rx_ring_blocks.clear();
+	tx_ring_frames.clear();
+	memset(&rx_ring_req, 0, sizeof(rx_ring_req));
+	memset(&tx_ring_req, 0, sizeof(tx_ring_req));
+
+	if(ring == nullptr) {
+		return;
+	}
+
+	munmap(ring, ring_size);
+	ring = nullptr;
+	ring_size = 0;
+}
+
+void RawSocket::startReceiveRing() {
+	socket.async_wait(boost::asio::socket_base::wait_read,
+	                  boost::bind(&RawSocket::handleReceiveRing,
+	                              this,
+	                              boost::asio::placeholders::error
+	                  )
+	);
+}
+
+void RawSocket::handleReceiveRing(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	const bool rx_timestamps = parameter_rx_timestamps.get();
+	const bool zero_copy = parameter_rx_ring_hold_time.get() > 0;
+
+	// Process all blocks that have been retired by the kernel
+	while(true) {
+		RxRingBlock &block = *rx_ring_blocks[rx_ring_block_index];
+		if(block.held) {
+			// All blocks are in use, so the packets of the oldest one are
+			// copied to let the kernel fill it again
+			block.detachAll();
+			break;
+		}
+
+		tpacket_block_desc *descriptor = block.descriptor;
+		if((__atomic_load_n(&descriptor->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0) {
+			break;
+		}
+
+		const uint32_t num_pkts = descriptor->hdr.bh1.num_pkts;
+		auto frame = reinterpret_cast<tpacket3_hdr*>(reinterpret_cast<uint8_t*>(descriptor) + descriptor->hdr.bh1.offset_to_first_pkt);
+		for(uint32_t i = 0; i < num_pkts; ++i) {
+			uint8_t *data = reinterpret_cast<uint8_t*>(frame) + frame->tp_mac;
+			auto packet = zero_copy ? Packet::create(data, frame->tp_snaplen, block) : Packet::create(const_cast<const uint8_t*>(data), frame->tp_snaplen);
+			if(rx_timestamps) {
+				packet->setIngressTimePoint(toTimePoint(frame->tp_sec, frame->tp_nsec));
+			}
+			rx_ring_batch.push_back(move(packet));
+
+			frame = reinterpret_cast<tpacket3_hdr*>(reinterpret_cast<uint8_t*>(frame) + frame->tp_next_offset);
+		}
+
+		// All frames of a block are passed through the graph as one batch
+		deliver(Span<PacketRef>(rx_ring_batch));
+		rx_ring_batch.clear();
+
+		// Hand block back to the kernel once no packet references it anymore
+		block.held = true;
+		block.held_since = chrono::high_resolution_clock::now();
+		if(block.buffers.empty()) {
+			block.handBack();
+		} else {
+			scheduleRxRingHoldCheck(block.held_since);
+		}
+
+		rx_ring_block_index = (rx_ring_block_index + 1) % rx_ring_blocks.size();
+	}
+
+	// The kernel is filling the current block, the one after it has to be
+	// available before the kernel needs it
+	RxRingBlock &next_block = *rx_ring_blocks[(rx_ring_block_index + 1) % rx_ring_blocks.size()];
+	if(next_block.held) {
+		next_block.detachAll();
+	}
+
+	startReceiveRing();
+}
+
+// The timer only runs while blocks are held by packets, so that an idle
+// socket is not woken up
+void RawSocket::scheduleRxRingHoldCheck(chrono::high_resolution_clock::time_point held_since) {
+	if(rx_ring_hold_pending) {
+		return;
+	}
+	rx_ring_hold_pending = true;
+
+	const auto hold_time = chrono::duration_cast<chrono::high_resolution_clock::duration>(chrono::duration<double, milli>(parameter_rx_ring_hold_time.get()));
+	timer_rx_ring_hold.expires_at(held_since + hold_time);
+	timer_rx_ring_hold.async_wait(boost::bind(&RawSocket::checkRxRingHold, this, boost::asio::placeholders::error));
+}
+
+void RawSocket::checkRxRingHold(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+	rx_ring_hold_pending = false;
+
+	const auto hold_time = chrono::duration_cast<chrono::high_resolution_clock::duration>(chrono::duration<double, milli>(parameter_rx_ring_hold_time.get()));
+	const auto now = chrono::high_resolution_clock::now();
+	bool blocks_held = false;
+	chrono::high_resolution_clock::time_point oldest_held_since;
+	for(auto &block : rx_ring_blocks) {
+		if(!block->held) {
+			continue;
+		}
+
+		if(now - block->held_since >= hold_time) {
+			block->detachAll();
+		} else if(!blocks_held || block->held_since < oldest_held_since) {
+			blocks_held = true;
+			oldest_held_since = block->held_since;
+		}
+	}
+
+	if(blocks_held) {
+		scheduleRxRingHoldCheck(oldest_held_since);
+	}
+}
+
+void RawSocket::RxRingBlock::attach(PacketBuffer &buffer) {
+	buffer.setOwnerIndex(buffers.size());
+	buffers.push_back(&buffer);
+}
+
+void RawSocket::RxRingBlock::release(PacketBuffer &buffer) {
+	// Fill the gap with the last buffer
+	const size_t index = buffer.getOwnerIndex();
+	buffers[index] = buffers.back();
+	buffers[index]->setOwnerIndex(index);
+	buffers.pop_back();
+
+	if(held && buffers.empty()) {
+		handBack();
+	}
+}
+
+void RawSocket::RxRingBlock::detachAll() {
+	while(!buffers.empty()) {
+		buffers.back()->detach();
+	}
+}
+
+void RawSocket::RxRingBlock::handBack() {
+	held = false;
+	__atomic_store_n(&descriptor->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+}
+
+void RawSocket::updateKernelStatistics() {
+	if(!socket.is_open()) {
+		return;
+	}
+
+	// Use the larger v3 layout for both modes, the kernel only fills what applies
+	tpacket_stats_v3 stats;
+	memset(&stats, 0, sizeof(stats));
+	socklen_t stats_size = sizeof(stats);
+	if(getsockopt(socket.native_handle(), SOL_PACKET, PACKET_STATISTICS, &stats, &stats_size) < 0) {
+		return;
+	}
+
+	rx_packets += stats.tp_packets;
+	rx_drops += stats.tp_drops;
+	if(!rx_ring_blocks.empty()) {
+		rx_freezes += stats.tp_freeze_q_cnt;
+	}
+}
+
+void RawSocket::statistics(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	updateKernelStatistics();
+
+	statistic_rx_packets.set(rx_packets);
+	statistic_rx_drops.set(rx_drops);
+	statistic_rx_freezes.set(rx_freezes);
+	statistic_tx_packets.set(tx_packets);
+	statistic_tx_deferred.set(tx_deferred);
+	statistic_tx_dropped.set(tx_dropped);
+	statistic_tx_queue_length.set(tx_queue.size());
+
+	timer_statistics.expires_at(timer_statistics.expiry() + chrono::milliseconds(1000));
+	timer_statistics.async_wait(boost::bind(&RawSocket::statistics, this, boost::asio::placeholders::error));
+}
+
 RawSocket::~RawSocket() {
-	socket.cancel();
-	socket.close();
+	timer_statistics.cancel();
+
+	close();
 }
@@ -28,20 +28,28 @@
 #include <string>
 #include <memory>
 #include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <vector>
 
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 
 #include <sys/socket.h>
 #include <linux/if_packet.h>
+#include <sys/mman.h>
 #include <net/ethernet.h>
 
 #include "../Module.hpp"
 #include "../../utils/Packet.hpp"
+#include "../../utils/IoUring.hpp"
+#include "../../utils/BpfFilter.hpp"
+#include "../../utils/TimerWheel.hpp"
 
 class RawSocket : public Module {
 	public:
-		RawSocket(boost::asio::io_service& io_service, std::string ifname, PortInfo::Side ports_side);
+		RawSocket(boost::asio::io_service& io_service, std::string ifname, PortInfo::Side ports_side, bool fanout = false);
 		~RawSocket();
 
 		const char* getType() const {
@@ -49,16 +57,139 @@ class RawSocket : public Module {
 		}
 
 	private:
-		ReceivingPort<std::shared_ptr<Packet>> input_port;
-		SendingPort<std::shared_ptr<Packet>> output_port;
+		ReceivingPort<PacketRef> input_port;
+		SendingPort<PacketRef> output_port;
+		SendingPort<PacketRef> bypass_port;
 
-		void send(std::shared_ptr<Packet> packet);
+		ParameterString parameter_filter = {""};
+		ParameterStringSelect parameter_filter_mode = {"ignore", {"ignore", "bypass"}};
+		ParameterStringSelect parameter_rx_mode = {"recv", {"recv", "ring"}};
+		ParameterDouble parameter_rx_ring_block_size = {1024, 4, std::numeric_limits<double>::quiet_NaN(), 4};
+		ParameterDouble parameter_rx_ring_blocks = {64, 2, std::numeric_limits<double>::quiet_NaN(), 1};
+		ParameterDouble parameter_rx_ring_block_timeout = {1, 1, std::numeric_limits<double>::quiet_NaN(), 1};
+		ParameterDouble parameter_rx_ring_hold_time = {1, 0, std::numeric_limits<double>::quiet_NaN(), 1};
+		ParameterStringSelect parameter_tx_mode = {"send", {"send", "sendmmsg", "ring"}};
+		ParameterDouble parameter_tx_ring_frames = {512, 16, std::numeric_limits<double>::quiet_NaN(), 16};
+		ParameterDouble parameter_tx_queue_size = {10000, 1, std::numeric_limits<double>::quiet_NaN(), 1};
+		ParameterBool parameter_tx_qdisc_bypass = false;
+		ParameterDouble parameter_busy_poll = {0, 0, std::numeric_limits<double>::quiet_NaN(), 10};
+		ParameterBool parameter_rx_timestamps = false;
+		ParameterBool parameter_tx_time = false;
+		ParameterBool parameter_gso = false;
+
+		Statistic statistic_rx_packets;
+		Statistic statistic_rx_drops;
+		Statistic statistic_rx_freezes;
+		Statistic statistic_tx_packets;
+		Statistic statistic_tx_deferred;
+		Statistic statistic_tx_dropped;
+		Statistic statistic_tx_queue_length;
+
+		boost::asio::io_service &io_service;
+		std::string ifname;
+		Packet::Annotations::Side ingress_side;
+		bool fanout;
+
+		void open();
+		void close();
+		std::atomic<bool> reopen_pending = false;
+		void scheduleReopen();
+
+		void send(PacketRef packet);
+
+		// Frames that do not match the filter in bypass mode skip the graph
+		std::unique_ptr<BpfFilter> bypass_filter;
+		void attachFilter();
+		void deliver(PacketRef packet);
+		void deliver(Span<PacketRef> packets);
 
 		void startReceive();
 		void handleReceive(const boost::system::error_code& error, size_t bytes_transferred);
 
+		// Receive with recvmsg to get the kernel timestamps
+		void startReceiveTimestamped();
+		void handleReceiveTimestamped(const boost::system::error_code& error);
+		static std::chrono::high_resolution_clock::time_point toTimePoint(uint64_t sec, uint64_t nsec);
+
 		boost::asio::generic::raw_protocol::socket socket;
-		boost::array<uint8_t, 10000> recv_buffer;
+		// Large enough for GSO frames of 64 KiB with Ethernet, VLAN and
+		// virtio-net header
+		boost::array<uint8_t, Packet::vnet_header_size + 65536 + 18> recv_buffer;
+
+		// GSO frames carry a virtio-net header in front of the Ethernet header
+		bool vnet_hdr = false;
+		PacketRef createPacket(const uint8_t *data, size_t size);
+
+		// TPACKET_V3 rings, RX and TX share one mapping
+		uint8_t *ring = nullptr;
+		size_t ring_size = 0;
+		void setupRings(bool rx_ring_requested, bool tx_ring_requested);
+		void teardownRings();
+
+		tpacket_req3 rx_ring_req = {};
+		size_t rx_ring_block_index = 0;
+		void startReceiveRing();
+		void handleReceiveRing(const boost::system::error_code& error);
+
+		// Packets reference the frames of the block they have been received
+		// in, so a block is only handed back to the kernel once all of its
+		// packets are gone. Packets that are held for longer, e.g. by a
+		// delay, are copied instead.
+		struct RxRingBlock : public PacketBufferOwner {
+			tpacket_block_desc *descriptor;
+			std::vector<PacketBuffer*> buffers;
+			bool held = false;
+			std::chrono::high_resolution_clock::time_point held_since;
+
+			void attach(PacketBuffer &buffer);
+			void release(PacketBuffer &buffer);
+			void detachAll();
+			void handBack();
+		};
+		std::vector<std::unique_ptr<RxRingBlock>> rx_ring_blocks;
+		std::vector<PacketRef> rx_ring_batch;
+		WheelTimer timer_rx_ring_hold;
+		bool rx_ring_hold_pending = false;
+		void scheduleRxRingHoldCheck(std::chrono::high_resolution_clock::time_point held_since);
+		void checkRxRingHold(const boost::system::error_code& error);
+
+		// io_uring, if the I/O service has been given one
+		IoUring *io_uring = nullptr;
+		int io_uring_buffer_group = -1;
+		void startReceiveUring();
+		void handleReceiveUring(int result, uint32_t flags);
+
+		tpacket_req3 tx_ring_req = {};
+		std::vector<tpacket3_hdr*> tx_ring_frames;
+		size_t tx_ring_frame_index = 0;
+
+		// Batched transmission
+		enum class TxMode {send, sendmmsg, ring, uring};
+		TxMode tx_mode = TxMode::send;
+		std::deque<PacketRef> tx_queue;
+		size_t tx_queue_deferred = 0;
+		bool tx_flush_pending = false;
+		void scheduleFlush();
+		void flush();
+		void flushSendmmsg();
+		void flushRing();
+		void flushUring();
+		size_t tx_inflight = 0;
+		void deferFlush();
+		void popTxQueue(size_t count);
+		void handleWritable(const boost::system::error_code& error);
+
+		uint64_t tx_packets = 0;
+		uint64_t tx_deferred = 0;
+		uint64_t tx_dropped = 0;
+
+		uint64_t rx_packets = 0;
+		uint64_t rx_drops = 0;
+		uint64_t rx_freezes = 0;
+		void updateKernelStatistics();
+
+		WheelTimer timer_statistics;
+		void statistics(const boost::system::error_code& error);
 };
 
 #endif
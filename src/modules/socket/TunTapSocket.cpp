@@ -0,0 +1,298 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: https://www.kernel.org/doc/html/latest/networking/tuntap.html
+
+#include "TunTapSocket.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/if_tun.h>
+
+#include <boost/bind.hpp>
+
+#include "../../utils/VirtioNet.hpp"
+
+using namespace std;
+
+// TUN devices carry IP packets only, so a placeholder Ethernet header is
+// added on reception and removed on transmission. This way, modules can
+// handle packets the same way as those of the other sockets.
+static constexpr size_t ethernet_header_length = 14;
+
+TunTapSocket::TunTapSocket(boost::asio::io_service& io_service, std::string ifname, PortInfo::Side ports_side, Mode mode) : io_service(io_service), ifname(ifname), mode(mode), timer_statistics(io_service) {
+	setName((mode == Mode::tun) ? "TUN Socket" : "TAP Socket");
+
+	// A socket with its ports on the right is at the left edge of the graph
+	ingress_side = (ports_side == PortInfo::Side::right) ? Packet::Annotations::Side::left : Packet::Annotations::Side::right;
+	switch(ports_side) {
+		case PortInfo::Side::left:
+			addPort({"in", "In", PortInfo::Side::left, &input_port});
+			addPort({"out", "Out", PortInfo::Side::left, &output_port});
+			break;
+		case PortInfo::Side::right:
+			addPort({"out", "Out", PortInfo::Side::right, &output_port});
+			addPort({"in", "In", PortInfo::Side::right, &input_port});
+			break;
+	}
+	addParameter({"queues", "Queues", "", &parameter_queues});
+	addParameter({"gso", "GSO", "", &parameter_gso});
+	addStatistic({"rx_packets", "Packets Received", "", &statistic_rx_packets});
+	addStatistic({"tx_packets", "Packets Sent", "", &statistic_tx_packets});
+	addStatistic({"tx_dropped", "Packets Dropped", "", &statistic_tx_dropped});
+
+	input_port.setReceiveHandler<&TunTapSocket::send>(this);
+
+	open();
+
+	parameter_queues.addChangeHandler(bind(&TunTapSocket::scheduleReopen, this));
+	parameter_gso.addChangeHandler(bind(&TunTapSocket::scheduleReopen, this));
+
+	// Start statistics timer
+	timer_statistics.expires_from_now(chrono::milliseconds(0));
+	timer_statistics.async_wait(boost::bind(&TunTapSocket::statistics, this, boost::asio::placeholders::error));
+}
+
+void TunTapSocket::open() {
+	// The new queues are attached before the old ones are closed, so that
+	// the device and its configuration survive a reconfiguration
+	vector<unique_ptr<Queue>> new_queues;
+	const size_t queue_count = parameter_queues.get();
+	for(size_t i = 0; i < queue_count; ++i) {
+		const int fd = ::open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if(fd < 0) {
+			cerr << "Cannot open /dev/net/tun: " << strerror(errno) << "!" << endl;
+			break;
+		}
+
+		ifreq ifr;
+		memset(&ifr, 0, sizeof(ifr));
+		strncpy(ifr.ifr_name, ifname.c_str(), IFNAMSIZ - 1);
+		ifr.ifr_flags = ((mode == Mode::tun) ? IFF_TUN : IFF_TAP) | IFF_NO_PI | IFF_MULTI_QUEUE | IFF_VNET_HDR | IFF_NAPI;
+		if(ioctl(fd, TUNSETIFF, &ifr) < 0) {
+			// NAPI is not available on older kernels or without CAP_NET_ADMIN
+			ifr.ifr_flags &= ~IFF_NAPI;
+			if(ioctl(fd, TUNSETIFF, &ifr) < 0) {
+				cerr << "Cannot attach queue " << i << " of " << ifname << ": " << strerror(errno) << "!" << endl;
+				::close(fd);
+				break;
+			}
+		}
+
+		// Without offloads, the kernel segments packets and computes
+		// checksums before handing them over
+		unsigned int offload = 0;
+		if(parameter_gso.get()) {
+			offload = TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN;
+		}
+		if(ioctl(fd, TUNSETOFFLOAD, offload) < 0) {
+			cerr << "Cannot set offloads of " << ifname << ": " << strerror(errno) << "!" << endl;
+		}
+
+		auto queue = make_unique<Queue>(io_service);
+		queue->descriptor.assign(fd);
+		new_queues.push_back(move(queue));
+	}
+
+	close();
+	queues = move(new_queues);
+
+	if(queues.empty()) {
+		return;
+	}
+
+	if(!setInterfaceUp()) {
+		cerr << "Cannot bring up " << ifname << ": " << strerror(errno) << "!" << endl;
+	}
+
+	for(size_t i = 0; i < queues.size(); ++i) {
+		startReceive(i);
+	}
+}
+
+void TunTapSocket::close() {
+	for(auto &queue : queues) {
+		queue->descriptor.cancel();
+		queue->descriptor.close();
+	}
+	queues.clear();
+}
+
+void TunTapSocket::scheduleReopen() {
+	// Parameters are changed from the MQTT thread, so the device is
+	// reconfigured on the thread that runs the I/O service
+	if(reopen_pending.exchange(true)) {
+		return;
+	}
+
+	post(io_service, [this]() {
+		reopen_pending = false;
+
+		open();
+	});
+}
+
+bool TunTapSocket::setInterfaceUp() {
+	const int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if(fd < 0) {
+		return false;
+	}
+
+	ifreq ifr;
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, ifname.c_str(), IFNAMSIZ - 1);
+	bool success = (ioctl(fd, SIOCGIFFLAGS, &ifr) == 0);
+	if(success && !(ifr.ifr_flags & IFF_UP)) {
+		ifr.ifr_flags |= IFF_UP;
+		success = (ioctl(fd, SIOCSIFFLAGS, &ifr) == 0);
+	}
+
+	::close(fd);
+
+	return success;
+}
+
+void TunTapSocket::startReceive(size_t queue) {
+	queues[queue]->descriptor.async_read_some(boost::asio::buffer(queues[queue]->recv_buffer),
+	                                          boost::bind(&TunTapSocket::handleReceive,
+	                                                      this,
+	                                                      queue,
+	                                                      boost::asio::placeholders::error,
+	                                                      boost::asio::placeholders::bytes_transferred
+	                                          )
+	);
+}
+
+void TunTapSocket::handleReceive(size_t queue, const boost::system::error_code& error, size_t bytes_transferred) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	if(!error && bytes_transferred > sizeof(virtio_net_hdr)) {
+		const uint8_t *recv_buffer = queues[queue]->recv_buffer.data();
+
+		virtio_net_hdr vnet_header;
+		memcpy(&vnet_header, recv_buffer, sizeof(vnet_header));
+		const uint8_t *data = recv_buffer + sizeof(vnet_header);
+		const size_t size = bytes_transferred - sizeof(vnet_header);
+
+		PacketRef packet;
+		if(mode == Mode::tun) {
+			vector<uint8_t> bytes(ethernet_header_length + size);
+			const uint16_t type_field = ((data[0] >> 4) == 6) ? 0x86DD : 0x0800;
+			bytes[12] = type_field >> 8;
+			bytes[13] = type_field;
+			memcpy(bytes.data() + ethernet_header_length, data, size);
+			packet = Packet::create(bytes);
+
+			// Offsets are relative to the start of the frame
+			if(vnet_header.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+				vnet_header.csum_start += ethernet_header_length;
+			}
+			if(vnet_header.gso_type != VIRTIO_NET_HDR_GSO_NONE) {
+				vnet_header.hdr_len += ethernet_header_length;
+			}
+		} else {
+			packet = Packet::create(data, size);
+		}
+
+		setVirtioNetHeader(*packet, vnet_header);
+		packet->getAnnotations().ingress_side = ingress_side;
+		output_port.send(move(packet));
+		rx_packets++;
+	}
+
+	startReceive(queue);
+}
+
+void TunTapSocket::send(PacketRef packet) {
+	if(queues.empty()) {
+		tx_dropped++;
+		return;
+	}
+
+	virtio_net_hdr vnet_header = getVirtioNetHeader(*packet);
+	const auto &packet_bytes = packet->getBytes();
+	const uint8_t *data = packet_bytes.data();
+	size_t size = packet_bytes.size();
+
+	if(mode == Mode::tun) {
+		if(size <= ethernet_header_length) {
+			tx_dropped++;
+			return;
+		}
+
+		data += ethernet_header_length;
+		size -= ethernet_header_length;
+
+		if(vnet_header.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+			vnet_header.csum_start -= ethernet_header_length;
+		}
+		if(vnet_header.gso_type != VIRTIO_NET_HDR_GSO_NONE) {
+			vnet_header.hdr_len -= ethernet_header_length;
+		}
+	}
+
+	// Keep the packets of a flow on one queue
+	size_t queue = 0;
+	if(queues.size() > 1) {
+		queue = packet->getHeaders().flow_hash % queues.size();
+	}
+
+	iovec iov[2];
+	iov[0].iov_base = &vnet_header;
+	iov[0].iov_len = sizeof(vnet_header);
+	iov[1].iov_base = const_cast<uint8_t*>(data);
+	iov[1].iov_len = size;
+	if(writev(queues[queue]->descriptor.native_handle(), iov, 2) < 0) {
+		tx_dropped++;
+		return;
+	}
+
+	tx_packets++;
+}
+
+void TunTapSocket::statistics(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	statistic_rx_packets.set(rx_packets);
+	statistic_tx_packets.set(tx_packets);
+	statistic_tx_dropped.set(tx_dropped);
+
+	timer_statistics.expires_at(timer_statistics.expiry() + chrono::milliseconds(1000));
+	timer_statistics.async_wait(boost::bind(&TunTapSocket::statistics, this, boost::asio::placeholders::error));
+}
+
+TunTapSocket::~TunTapSocket() {
+	timer_statistics.cancel();
+
+	close();
+}
@@ -0,0 +1,95 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: https://www.kernel.org/doc/html/latest/networking/tuntap.html
+
+#ifndef TUN_TAP_SOCKET_HPP
+#define TUN_TAP_SOCKET_HPP
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+
+#include <boost/array.hpp>
+#include <boost/asio.hpp>
+
+#include "../Module.hpp"
+#include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
+
+class TunTapSocket : public Module {
+	public:
+		enum class Mode {tun, tap};
+
+		TunTapSocket(boost::asio::io_service& io_service, std::string ifname, PortInfo::Side ports_side, Mode mode);
+		~TunTapSocket();
+
+		const char* getType() const {
+			return (mode == Mode::tun) ? "tun_socket" : "tap_socket";
+		}
+
+	private:
+		ReceivingPort<PacketRef> input_port;
+		SendingPort<PacketRef> output_port;
+
+		ParameterDouble parameter_queues = {1, 1, 256, 1};
+		ParameterBool parameter_gso = false;
+
+		Statistic statistic_rx_packets;
+		Statistic statistic_tx_packets;
+		Statistic statistic_tx_dropped;
+
+		boost::asio::io_service &io_service;
+		std::string ifname;
+		Packet::Annotations::Side ingress_side;
+		Mode mode;
+
+		void open();
+		void close();
+		std::atomic<bool> reopen_pending = false;
+		void scheduleReopen();
+
+		// Every queue of a multi-queue device has its own file descriptor
+		struct Queue {
+			Queue(boost::asio::io_service& io_service) : descriptor(io_service) {}
+
+			boost::asio::posix::stream_descriptor descriptor;
+			boost::array<uint8_t, Packet::vnet_header_size + 65536> recv_buffer;
+		};
+		std::vector<std::unique_ptr<Queue>> queues;
+		bool setInterfaceUp();
+
+		void startReceive(size_t queue);
+		void handleReceive(size_t queue, const boost::system::error_code& error, size_t bytes_transferred);
+
+		void send(PacketRef packet);
+
+		uint64_t rx_packets = 0;
+		uint64_t tx_packets = 0;
+		uint64_t tx_dropped = 0;
+
+		WheelTimer timer_statistics;
+		void statistics(const boost::system::error_code& error);
+};
+
+#endif
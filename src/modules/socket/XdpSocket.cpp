@@ -0,0 +1,596 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: https://www.kernel.org/doc/html/latest/networking/af_xdp.html
+// Reference: https://github.com/xdp-project/xdp-tutorial/tree/master/advanced03-AF_XDP
+
+#include "XdpSocket.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <cstddef>
+#include <iostream>
+
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+
+#include <boost/bind.hpp>
+
+using namespace std;
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+static int bpf(int cmd, bpf_attr &attr) {
+	return syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+}
+
+XdpSocket::XdpSocket(boost::asio::io_service& io_service, std::string ifname, PortInfo::Side ports_side) : io_service(io_service), ifname(ifname), timer_reopen(io_service), descriptor(io_service), timer_statistics(io_service) {
+	setName("XDP Socket");
+
+	// A socket with its ports on the right is at the left edge of the graph
+	ingress_side = (ports_side == PortInfo::Side::right) ? Packet::Annotations::Side::left : Packet::Annotations::Side::right;
+	switch(ports_side) {
+		case PortInfo::Side::left:
+			addPort({"in", "In", PortInfo::Side::left, &input_port});
+			addPort({"out", "Out", PortInfo::Side::left, &output_port});
+			break;
+		case PortInfo::Side::right:
+			addPort({"out", "Out", PortInfo::Side::right, &output_port});
+			addPort({"in", "In", PortInfo::Side::right, &input_port});
+			break;
+	}
+	addParameter({"xdp_mode", "XDP Mode", "", &parameter_xdp_mode});
+	addParameter({"queue", "Queue", "", &parameter_queue});
+	addParameter({"frames", "UMEM Frames", "", &parameter_frames});
+	addParameter({"tx_queue_size", "TX Queue", "packets", &parameter_tx_queue_size});
+	addParameter({"busy_poll", "Busy Poll", "µs", &parameter_busy_poll});
+	addStatistic({"rx_packets", "Packets Received", "", &statistic_rx_packets});
+	addStatistic({"rx_drops", "Packets Dropped by Kernel", "", &statistic_rx_drops});
+	addStatistic({"rx_ring_full", "RX Ring Full", "", &statistic_rx_ring_full});
+	addStatistic({"rx_fill_ring_empty", "Fill Ring Empty", "", &statistic_rx_fill_ring_empty});
+	addStatistic({"tx_packets", "Packets Sent", "", &statistic_tx_packets});
+	addStatistic({"tx_deferred", "Packets Deferred", "", &statistic_tx_deferred});
+	addStatistic({"tx_dropped", "Packets Dropped", "", &statistic_tx_dropped});
+	addStatistic({"tx_queue_length", "TX Queue", "packets", &statistic_tx_queue_length});
+
+	input_port.setReceiveHandler<&XdpSocket::send>(this);
+
+	open();
+
+	parameter_xdp_mode.addChangeHandler(bind(&XdpSocket::scheduleReopen, this));
+	parameter_queue.addChangeHandler(bind(&XdpSocket::scheduleReopen, this));
+	parameter_frames.addChangeHandler(bind(&XdpSocket::scheduleReopen, this));
+	parameter_busy_poll.addChangeHandler(bind(&XdpSocket::scheduleReopen, this));
+
+	// Start statistics timer
+	timer_statistics.expires_from_now(chrono::milliseconds(0));
+	timer_statistics.async_wait(boost::bind(&XdpSocket::statistics, this, boost::asio::placeholders::error));
+}
+
+void XdpSocket::open() {
+	const uint32_t ifindex = if_nametoindex(ifname.c_str());
+	const uint32_t queue = parameter_queue.get();
+	const bool native = parameter_xdp_mode.get() == "native";
+
+	// All rings are large enough to hold every frame of the UMEM, so
+	// frames can always be handed back without checking for space
+	const size_t frames = parameter_frames.get();
+	uint32_t ring_size = 1;
+	while(ring_size < frames) {
+		ring_size <<= 1;
+	}
+
+	const int fd = ::socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+	if(fd < 0) {
+		cerr << "Cannot open AF_XDP socket for " << ifname << ": " << strerror(errno) << "!" << endl;
+		return;
+	}
+	descriptor.assign(fd);
+
+	umem_size = frames * frame_size;
+	void *mapping = mmap(nullptr, umem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if(mapping == MAP_FAILED) {
+		cerr << "Cannot allocate UMEM for " << ifname << ": " << strerror(errno) << "!" << endl;
+		close();
+		return;
+	}
+	umem = static_cast<uint8_t*>(mapping);
+
+	xdp_umem_reg umem_reg;
+	memset(&umem_reg, 0, sizeof(umem_reg));
+	umem_reg.addr = reinterpret_cast<uint64_t>(umem);
+	umem_reg.len = umem_size;
+	umem_reg.chunk_size = frame_size;
+	umem_reg.headroom = 0;
+	if(setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &umem_reg, sizeof(umem_reg)) < 0) {
+		cerr << "Cannot register UMEM for " << ifname << ": " << strerror(errno) << "!" << endl;
+		close();
+		return;
+	}
+
+	for(int option : {XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING, XDP_RX_RING, XDP_TX_RING}) {
+		if(setsockopt(fd, SOL_XDP, option, &ring_size, sizeof(ring_size)) < 0) {
+			cerr << "Cannot set up AF_XDP rings for " << ifname << ": " << strerror(errno) << "!" << endl;
+			close();
+			return;
+		}
+	}
+
+	xdp_mmap_offsets offsets;
+	socklen_t offsets_size = sizeof(offsets);
+	if(getsockopt(fd, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &offsets_size) < 0 ||
+	   !mapRing(fill_ring, XDP_UMEM_PGOFF_FILL_RING, offsets.fr, ring_size, sizeof(uint64_t)) ||
+	   !mapRing(completion_ring, XDP_UMEM_PGOFF_COMPLETION_RING, offsets.cr, ring_size, sizeof(uint64_t)) ||
+	   !mapRing(rx_ring, XDP_PGOFF_RX_RING, offsets.rx, ring_size, sizeof(xdp_desc)) ||
+	   !mapRing(tx_ring, XDP_PGOFF_TX_RING, offsets.tx, ring_size, sizeof(xdp_desc))) {
+		cerr << "Cannot map AF_XDP rings of " << ifname << ": " << strerror(errno) << "!" << endl;
+		close();
+		return;
+	}
+
+	// Split UMEM between reception and transmission
+	auto fill_descs = static_cast<uint64_t*>(fill_ring.descs);
+	uint32_t fill_producer = *fill_ring.producer;
+	for(size_t i = 0; i < frames / 2; ++i) {
+		fill_descs[fill_producer++ & (fill_ring.size - 1)] = i * frame_size;
+	}
+	__atomic_store_n(fill_ring.producer, fill_producer, __ATOMIC_RELEASE);
+
+	free_frames.reserve(frames);
+	for(size_t i = frames / 2; i < frames; ++i) {
+		free_frames.push_back(i * frame_size);
+	}
+
+	if(parameter_busy_poll.get() > 0) {
+		const int busy_poll = parameter_busy_poll.get();
+		const int prefer_busy_poll = 1;
+		const int busy_poll_budget = 64;
+		if(setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)) < 0 ||
+		   setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer_busy_poll, sizeof(prefer_busy_poll)) < 0 ||
+		   setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL_BUDGET, &busy_poll_budget, sizeof(busy_poll_budget)) < 0) {
+			cerr << "Cannot enable busy polling on " << ifname << ": " << strerror(errno) << "!" << endl;
+		}
+	}
+
+	sockaddr_xdp sockaddr;
+	memset(&sockaddr, 0, sizeof(sockaddr));
+	sockaddr.sxdp_family = AF_XDP;
+	sockaddr.sxdp_ifindex = ifindex;
+	sockaddr.sxdp_queue_id = queue;
+	sockaddr.sxdp_flags = XDP_USE_NEED_WAKEUP | (native ? 0 : XDP_COPY);
+	if(::bind(fd, reinterpret_cast<struct sockaddr*>(&sockaddr), sizeof(sockaddr)) < 0) {
+		// The kernel releases the queue of a previous socket asynchronously
+		if(errno == EBUSY && bind_retries < 100) {
+			bind_retries++;
+			close();
+			timer_reopen.expires_from_now(chrono::milliseconds(10));
+			timer_reopen.async_wait([&](const boost::system::error_code& error) {
+				if(error != boost::asio::error::operation_aborted) {
+					open();
+				}
+			});
+			return;
+		}
+		bind_retries = 0;
+
+		cerr << "Cannot bind AF_XDP socket to queue " << queue << " of " << ifname << ": " << strerror(errno) << "!" << endl;
+		close();
+		return;
+	}
+
+	bind_retries = 0;
+
+	if(!attachProgram(ifindex, queue)) {
+		close();
+		return;
+	}
+
+	startReceive();
+
+	// Frames might have been left over from before a reconfiguration
+	if(!tx_queue.empty()) {
+		scheduleFlush();
+	}
+}
+
+void XdpSocket::close() {
+	// Kernel counters belong to the socket, so collect them before they are lost
+	updateKernelStatistics();
+	rx_drops += kernel_statistics.rx_dropped + kernel_statistics.rx_invalid_descs;
+	rx_ring_full += kernel_statistics.rx_ring_full;
+	rx_fill_ring_empty += kernel_statistics.rx_fill_ring_empty_descs;
+	memset(&kernel_statistics, 0, sizeof(kernel_statistics));
+
+	detachProgram();
+
+	// A pending wait for the socket to become writable is canceled, so the
+	// next open has to schedule a flush again
+	if(descriptor.is_open()) {
+		descriptor.cancel();
+		descriptor.close();
+	}
+	tx_flush_pending = false;
+
+	unmapRing(fill_ring);
+	unmapRing(completion_ring);
+	unmapRing(rx_ring);
+	unmapRing(tx_ring);
+	free_frames.clear();
+
+	if(umem != nullptr) {
+		munmap(umem, umem_size);
+		umem = nullptr;
+		umem_size = 0;
+	}
+}
+
+void XdpSocket::scheduleReopen() {
+	// Parameters are changed from the MQTT thread, so the socket is
+	// reconfigured on the thread that runs the I/O service
+	if(reopen_pending.exchange(true)) {
+		return;
+	}
+
+	post(io_service, [this]() {
+		reopen_pending = false;
+
+		timer_reopen.cancel();
+		close();
+		open();
+	});
+}
+
+bool XdpSocket::mapRing(Ring &ring, off_t offset, const xdp_ring_offset &ring_offset, uint32_t size, size_t desc_size) {
+	const size_t mapping_size = ring_offset.desc + size * desc_size;
+	void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor.native_handle(), offset);
+	if(mapping == MAP_FAILED) {
+		return false;
+	}
+
+	uint8_t *base = static_cast<uint8_t*>(mapping);
+	ring.producer = reinterpret_cast<uint32_t*>(base + ring_offset.producer);
+	ring.consumer = reinterpret_cast<uint32_t*>(base + ring_offset.consumer);
+	ring.flags = reinterpret_cast<uint32_t*>(base + ring_offset.flags);
+	ring.descs = base + ring_offset.desc;
+	ring.size = size;
+	ring.mapping = mapping;
+	ring.mapping_size = mapping_size;
+
+	return true;
+}
+
+void XdpSocket::unmapRing(Ring &ring) {
+	if(ring.mapping != nullptr) {
+		munmap(ring.mapping, ring.mapping_size);
+	}
+
+	ring = Ring();
+}
+
+bool XdpSocket::attachProgram(uint32_t ifindex, uint32_t queue) {
+	bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_XSKMAP;
+	attr.key_size = sizeof(uint32_t);
+	attr.value_size = sizeof(uint32_t);
+	attr.max_entries = queue + 1;
+	xsk_map_fd = bpf(BPF_MAP_CREATE, attr);
+	if(xsk_map_fd < 0) {
+		cerr << "Cannot create XSKMAP for " << ifname << ": " << strerror(errno) << "!" << endl;
+		return false;
+	}
+
+	// return bpf_redirect_map(&xsk_map, ctx->rx_queue_index, XDP_PASS);
+	//
+	// Frames of other queues and frames of this queue that find no socket
+	// in the map are passed on to the network stack.
+	bpf_insn program[] = {
+		{BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, offsetof(xdp_md, rx_queue_index), 0},
+		{BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, xsk_map_fd},
+		{0, 0, 0, 0, 0},
+		{BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS},
+		{BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map},
+		{BPF_JMP | BPF_EXIT, 0, 0, 0, 0},
+	};
+	const char license[] = "GPL";
+
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_XDP;
+	attr.insns = reinterpret_cast<uint64_t>(program);
+	attr.insn_cnt = sizeof(program) / sizeof(program[0]);
+	attr.license = reinterpret_cast<uint64_t>(license);
+	xdp_program_fd = bpf(BPF_PROG_LOAD, attr);
+	if(xdp_program_fd < 0) {
+		cerr << "Cannot load XDP program for " << ifname << ": " << strerror(errno) << "!" << endl;
+		return false;
+	}
+
+	xsk_map_key = queue;
+	const uint32_t key = queue;
+	const uint32_t value = descriptor.native_handle();
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = xsk_map_fd;
+	attr.key = reinterpret_cast<uint64_t>(&key);
+	attr.value = reinterpret_cast<uint64_t>(&value);
+	attr.flags = BPF_ANY;
+	if(bpf(BPF_MAP_UPDATE_ELEM, attr) < 0) {
+		cerr << "Cannot insert AF_XDP socket into XSKMAP of " << ifname << ": " << strerror(errno) << "!" << endl;
+		return false;
+	}
+
+	// The link detaches the program again as soon as it is closed, even if
+	// FlowEmu is not shut down cleanly
+	memset(&attr, 0, sizeof(attr));
+	attr.link_create.prog_fd = xdp_program_fd;
+	attr.link_create.target_ifindex = ifindex;
+	attr.link_create.attach_type = BPF_XDP;
+	attr.link_create.flags = (parameter_xdp_mode.get() == "native") ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+	xdp_link_fd = bpf(BPF_LINK_CREATE, attr);
+	if(xdp_link_fd < 0) {
+		cerr << "Cannot attach XDP program to " << ifname << ": " << strerror(errno) << "!" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+void XdpSocket::detachProgram() {
+	// The map would keep the socket bound to the queue until it is freed
+	// asynchronously, which makes an immediate reopen fail
+	if(xsk_map_fd >= 0) {
+		const uint32_t key = xsk_map_key;
+		bpf_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.map_fd = xsk_map_fd;
+		attr.key = reinterpret_cast<uint64_t>(&key);
+		bpf(BPF_MAP_DELETE_ELEM, attr);
+	}
+
+	for(int *fd : {&xdp_link_fd, &xdp_program_fd, &xsk_map_fd}) {
+		if(*fd >= 0) {
+			::close(*fd);
+			*fd = -1;
+		}
+	}
+}
+
+void XdpSocket::startReceive() {
+	descriptor.async_wait(boost::asio::posix::descriptor_base::wait_read,
+	                      boost::bind(&XdpSocket::handleReceive,
+	                                  this,
+	                                  boost::asio::placeholders::error
+	                      )
+	);
+}
+
+void XdpSocket::handleReceive(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	auto rx_descs = static_cast<xdp_desc*>(rx_ring.descs);
+	auto fill_descs = static_cast<uint64_t*>(fill_ring.descs);
+
+	uint32_t rx_consumer = *rx_ring.consumer;
+	const uint32_t rx_producer = __atomic_load_n(rx_ring.producer, __ATOMIC_ACQUIRE);
+	uint32_t fill_producer = *fill_ring.producer;
+	while(rx_consumer != rx_producer) {
+		const xdp_desc &desc = rx_descs[rx_consumer & (rx_ring.size - 1)];
+		auto packet = Packet::create(umem + desc.addr, desc.len);
+		packet->getAnnotations().ingress_side = ingress_side;
+		rx_batch.push_back(move(packet));
+		rx_packets++;
+
+		// Hand frame back to the kernel, the address might carry an offset
+		fill_descs[fill_producer & (fill_ring.size - 1)] = desc.addr & ~static_cast<uint64_t>(frame_size - 1);
+
+		rx_consumer++;
+		fill_producer++;
+	}
+	__atomic_store_n(rx_ring.consumer, rx_consumer, __ATOMIC_RELEASE);
+	__atomic_store_n(fill_ring.producer, fill_producer, __ATOMIC_RELEASE);
+
+	// Frames are copied, so the batch is passed on after the frames have
+	// been handed back
+	output_port.send(Span<PacketRef>(rx_batch));
+	rx_batch.clear();
+
+	if(__atomic_load_n(fill_ring.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP) {
+		recvfrom(descriptor.native_handle(), nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+	}
+
+	startReceive();
+}
+
+void XdpSocket::send(PacketRef packet) {
+	if(tx_queue.size() >= parameter_tx_queue_size.get()) {
+		tx_dropped++;
+		return;
+	}
+
+	// Collect frames until the current event loop turn is over
+	tx_queue.emplace_back(packet);
+	scheduleFlush();
+}
+
+void XdpSocket::scheduleFlush() {
+	if(tx_flush_pending) {
+		return;
+	}
+	tx_flush_pending = true;
+
+	post(io_service, bind(&XdpSocket::flush, this));
+}
+
+void XdpSocket::flush() {
+	tx_flush_pending = false;
+
+	if(!descriptor.is_open() || tx_ring.mapping == nullptr) {
+		return;
+	}
+
+	reclaim();
+
+	auto tx_descs = static_cast<xdp_desc*>(tx_ring.descs);
+
+	uint32_t tx_producer = *tx_ring.producer;
+	const uint32_t tx_consumer = __atomic_load_n(tx_ring.consumer, __ATOMIC_ACQUIRE);
+	bool frames_queued = false;
+	while(!tx_queue.empty()) {
+		if(free_frames.empty() || tx_producer - tx_consumer >= tx_ring.size) {
+			// Ring is full or all frames are still in flight
+			break;
+		}
+
+		const auto &packet_bytes = tx_queue.front()->getBytes();
+		if(packet_bytes.size() > frame_size) {
+			tx_dropped++;
+			popTxQueue(1);
+			continue;
+		}
+
+		const uint64_t address = free_frames.back();
+		free_frames.pop_back();
+		memcpy(umem + address, packet_bytes.data(), packet_bytes.size());
+
+		xdp_desc &desc = tx_descs[tx_producer & (tx_ring.size - 1)];
+		desc.addr = address;
+		desc.len = packet_bytes.size();
+		desc.options = 0;
+
+		tx_producer++;
+		tx_packets++;
+		popTxQueue(1);
+		frames_queued = true;
+	}
+
+	if(frames_queued) {
+		__atomic_store_n(tx_ring.producer, tx_producer, __ATOMIC_RELEASE);
+	}
+
+	// Kick the kernel once for all frames of this turn, this also drives
+	// completions if all frames are in flight
+	if((frames_queued || free_frames.empty()) && (__atomic_load_n(tx_ring.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP)) {
+		if(sendto(descriptor.native_handle(), nullptr, 0, MSG_DONTWAIT, nullptr, 0) < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EBUSY && errno != ENOBUFS && errno != ENETDOWN) {
+			cerr << "Cannot transmit TX ring of " << ifname << ": " << strerror(errno) << "!" << endl;
+		}
+	}
+
+	if(!tx_queue.empty()) {
+		deferFlush();
+	}
+}
+
+void XdpSocket::reclaim() {
+	auto completion_descs = static_cast<uint64_t*>(completion_ring.descs);
+
+	uint32_t completion_consumer = *completion_ring.consumer;
+	const uint32_t completion_producer = __atomic_load_n(completion_ring.producer, __ATOMIC_ACQUIRE);
+	while(completion_consumer != completion_producer) {
+		free_frames.push_back(completion_descs[completion_consumer & (completion_ring.size - 1)]);
+		completion_consumer++;
+	}
+	__atomic_store_n(completion_ring.consumer, completion_consumer, __ATOMIC_RELEASE);
+}
+
+void XdpSocket::popTxQueue(size_t count) {
+	for(size_t i = 0; i < count; ++i) {
+		tx_queue.pop_front();
+	}
+
+	tx_queue_deferred = (tx_queue_deferred > count) ? tx_queue_deferred - count : 0;
+}
+
+void XdpSocket::deferFlush() {
+	// Count every frame only once, even if it has to wait several times
+	tx_deferred += tx_queue.size() - tx_queue_deferred;
+	tx_queue_deferred = tx_queue.size();
+
+	tx_flush_pending = true;
+	descriptor.async_wait(boost::asio::posix::descriptor_base::wait_write,
+	                      boost::bind(&XdpSocket::handleWritable,
+	                                  this,
+	                                  boost::asio::placeholders::error
+	                      )
+	);
+}
+
+void XdpSocket::handleWritable(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	flush();
+}
+
+void XdpSocket::updateKernelStatistics() {
+	if(!descriptor.is_open()) {
+		return;
+	}
+
+	xdp_statistics stats;
+	memset(&stats, 0, sizeof(stats));
+	socklen_t stats_size = sizeof(stats);
+	if(getsockopt(descriptor.native_handle(), SOL_XDP, XDP_STATISTICS, &stats, &stats_size) < 0) {
+		return;
+	}
+
+	kernel_statistics = stats;
+}
+
+void XdpSocket::statistics(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	updateKernelStatistics();
+
+	statistic_rx_packets.set(rx_packets);
+	statistic_rx_drops.set(rx_drops + kernel_statistics.rx_dropped + kernel_statistics.rx_invalid_descs);
+	statistic_rx_ring_full.set(rx_ring_full + kernel_statistics.rx_ring_full);
+	statistic_rx_fill_ring_empty.set(rx_fill_ring_empty + kernel_statistics.rx_fill_ring_empty_descs);
+	statistic_tx_packets.set(tx_packets);
+	statistic_tx_deferred.set(tx_deferred);
+	statistic_tx_dropped.set(tx_dropped);
+	statistic_tx_queue_length.set(tx_queue.size());
+
+	timer_statistics.expires_at(timer_statistics.expiry() + chrono::milliseconds(1000));
+	timer_statistics.async_wait(boost::bind(&XdpSocket::statistics, this, boost::asio::placeholders::error));
+}
+
+XdpSocket::~XdpSocket() {
+	timer_statistics.cancel();
+	timer_reopen.cancel();
+
+	close();
+}
@@ -0,0 +1,145 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: https://www.kernel.org/doc/html/latest/networking/af_xdp.html
+
+#ifndef XDP_SOCKET_HPP
+#define XDP_SOCKET_HPP
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include <linux/if_xdp.h>
+
+#include "../Module.hpp"
+#include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
+
+class XdpSocket : public Module {
+	public:
+		XdpSocket(boost::asio::io_service& io_service, std::string ifname, PortInfo::Side ports_side);
+		~XdpSocket();
+
+		const char* getType() const {
+			return "xdp_socket";
+		}
+
+	private:
+		ReceivingPort<PacketRef> input_port;
+		SendingPort<PacketRef> output_port;
+
+		ParameterStringSelect parameter_xdp_mode = {"skb", {"skb", "native"}};
+		ParameterDouble parameter_queue = {0, 0, std::numeric_limits<double>::quiet_NaN(), 1};
+		ParameterDouble parameter_frames = {4096, 64, std::numeric_limits<double>::quiet_NaN(), 64};
+		ParameterDouble parameter_tx_queue_size = {10000, 1, std::numeric_limits<double>::quiet_NaN(), 1};
+		ParameterDouble parameter_busy_poll = {0, 0, std::numeric_limits<double>::quiet_NaN(), 10};
+
+		Statistic statistic_rx_packets;
+		Statistic statistic_rx_drops;
+		Statistic statistic_rx_ring_full;
+		Statistic statistic_rx_fill_ring_empty;
+		Statistic statistic_tx_packets;
+		Statistic statistic_tx_deferred;
+		Statistic statistic_tx_dropped;
+		Statistic statistic_tx_queue_length;
+
+		boost::asio::io_service &io_service;
+		std::string ifname;
+		Packet::Annotations::Side ingress_side;
+
+		void open();
+		void close();
+		std::atomic<bool> reopen_pending = false;
+		void scheduleReopen();
+		WheelTimer timer_reopen;
+		unsigned int bind_retries = 0;
+
+		// Rings shared with the kernel
+		struct Ring {
+			uint32_t *producer = nullptr;
+			uint32_t *consumer = nullptr;
+			uint32_t *flags = nullptr;
+			void *descs = nullptr;
+			uint32_t size = 0;
+			void *mapping = nullptr;
+			size_t mapping_size = 0;
+		};
+		bool mapRing(Ring &ring, off_t offset, const xdp_ring_offset &ring_offset, uint32_t size, size_t desc_size);
+		void unmapRing(Ring &ring);
+
+		static constexpr size_t frame_size = 4096;
+
+		boost::asio::posix::stream_descriptor descriptor;
+		uint8_t *umem = nullptr;
+		size_t umem_size = 0;
+		Ring fill_ring;
+		Ring completion_ring;
+		Ring rx_ring;
+		Ring tx_ring;
+		std::vector<uint64_t> free_frames;
+
+		// XDP program redirecting the queue to the socket
+		int xsk_map_fd = -1;
+		uint32_t xsk_map_key = 0;
+		int xdp_program_fd = -1;
+		int xdp_link_fd = -1;
+		bool attachProgram(uint32_t ifindex, uint32_t queue);
+		void detachProgram();
+
+		void startReceive();
+		void handleReceive(const boost::system::error_code& error);
+		std::vector<PacketRef> rx_batch;
+
+		void send(PacketRef packet);
+
+		std::deque<PacketRef> tx_queue;
+		size_t tx_queue_deferred = 0;
+		bool tx_flush_pending = false;
+		void scheduleFlush();
+		void flush();
+		void reclaim();
+		void popTxQueue(size_t count);
+		void deferFlush();
+		void handleWritable(const boost::system::error_code& error);
+
+		uint64_t rx_packets = 0;
+		uint64_t rx_drops = 0;
+		uint64_t rx_ring_full = 0;
+		uint64_t rx_fill_ring_empty = 0;
+		uint64_t tx_packets = 0;
+		uint64_t tx_deferred = 0;
+		uint64_t tx_dropped = 0;
+
+		// Kernel counters of the current socket, folded into the totals on close
+		xdp_statistics kernel_statistics = {};
+		void updateKernelStatistics();
+
+		WheelTimer timer_statistics;
+		void statistics(const boost::system::error_code& error);
+};
+
+#endif
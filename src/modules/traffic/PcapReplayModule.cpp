@@ -0,0 +1,189 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "PcapReplayModule.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <list>
+
+#include <boost/bind.hpp>
+
+using namespace std;
+
+// Upper bound of packets sent at once, so that other handlers still run
+static constexpr size_t burst_size = 256;
+
+// Replay restarts from the current time if it has fallen behind by more
+// than this, instead of trying to catch up
+static constexpr chrono::seconds backlog_limit(1);
+
+// Interval in which to check for a capture if none is loaded or the end of
+// the capture was reached without looping
+static constexpr chrono::milliseconds idle_interval(100);
+
+PcapReplayModule::PcapReplayModule(boost::asio::io_service &io_service, const string &captures_path) : io_service(io_service), timer(io_service), timer_statistics(io_service) {
+	setName("PCAP Replay");
+	addPort({"out", "Out", PortInfo::Side::right, &output_port});
+	addParameter({"capture_filename", "Capture", "", &parameter_capture_filename});
+	addParameter({"timing", "Timing", "", &parameter_timing});
+	addParameter({"speedup", "Speed-Up", "", &parameter_speedup});
+	addParameter({"loop", "Loop", "", &parameter_loop});
+	addStatistic({"packets", "Packets Sent", "", &statistic_packets});
+
+	// The capture is only accessed by the handlers of the I/O service
+	parameter_capture_filename.addChangeHandler([&, captures_path](string capture_filename) {
+		post(this->io_service, [this, captures_path, capture_filename]() {
+			loadCapture(captures_path + "/" + capture_filename);
+		});
+	});
+	parameter_timing.addChangeHandler([&](string timing) {
+		synchronize = true;
+	});
+	parameter_speedup.addChangeHandler([&](double speedup) {
+		synchronize = true;
+	});
+
+	listCaptures(captures_path);
+
+	timer.expires_from_now(chrono::milliseconds(0));
+	timer.async_wait(boost::bind(&PcapReplayModule::process, this, boost::asio::placeholders::error));
+
+	// Start statistics timer
+	timer_statistics.expires_from_now(chrono::milliseconds(0));
+	timer_statistics.async_wait(boost::bind(&PcapReplayModule::statistics, this, boost::asio::placeholders::error));
+}
+
+void PcapReplayModule::listCaptures(const string &path) {
+	if(!filesystem::exists(path)) {
+		cerr << "Path " << path << " does not exist!" << endl;
+		return;
+	}
+
+	std::list<std::string> capture_filenames;
+	for(const auto &entry : filesystem::directory_iterator(path)) {
+		if(entry.path().filename().extension() == ".md") {
+			continue;
+		}
+
+		capture_filenames.push_back(entry.path().filename().string());
+	}
+
+	capture_filenames.sort();
+
+	parameter_capture_filename.setOptions(capture_filenames);
+}
+
+void PcapReplayModule::loadCapture(const string &capture_filename) {
+	capture.reset();
+	record_pending = false;
+	synchronize = true;
+
+	try {
+		capture = make_unique<CaptureFile>(capture_filename);
+	} catch(const runtime_error &e) {
+		cerr << e.what() << "!" << endl;
+	}
+}
+
+void PcapReplayModule::process(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	const auto now = chrono::high_resolution_clock::now();
+
+	if(!capture) {
+		timer.expires_at(now + idle_interval);
+		timer.async_wait(boost::bind(&PcapReplayModule::process, this, boost::asio::placeholders::error));
+		return;
+	}
+
+	const bool maximum = (parameter_timing.get() == "maximum");
+	const double speedup = (parameter_timing.get() == "speedup") ? parameter_speedup.get() : 1;
+
+	auto next_time_point = now;
+	bool end = false;
+	for(size_t i = 0; i < burst_size; ++i) {
+		if(!record_pending) {
+			if(!capture->next(record)) {
+				if(!parameter_loop.get()) {
+					end = true;
+					break;
+				}
+
+				capture->rewind();
+				synchronize = true;
+				if(!capture->next(record)) {
+					end = true;
+					break;
+				}
+			}
+			record_pending = true;
+		}
+
+		if(!maximum) {
+			if(synchronize.exchange(false)) {
+				start_time_point = now;
+				capture_start_time = record.timestamp;
+			}
+
+			// Timestamps are relative to the first record, so that
+			// records out of order are sent immediately
+			next_time_point = start_time_point + chrono::duration_cast<chrono::high_resolution_clock::duration>(chrono::duration<double, nano>((record.timestamp - capture_start_time).count() / speedup));
+			if(next_time_point > now) {
+				break;
+			}
+
+			if(now - next_time_point > backlog_limit) {
+				synchronize = true;
+			}
+		}
+
+		packets++;
+		output_port.send(Packet::create(record.data, record.size));
+		record_pending = false;
+	}
+
+	if(end) {
+		timer.expires_at(now + idle_interval);
+	} else {
+		timer.expires_at(max(next_time_point, now));
+	}
+	timer.async_wait(boost::bind(&PcapReplayModule::process, this, boost::asio::placeholders::error));
+}
+
+void PcapReplayModule::statistics(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	statistic_packets.set(packets);
+
+	timer_statistics.expires_at(timer_statistics.expiry() + chrono::milliseconds(1000));
+	timer_statistics.async_wait(boost::bind(&PcapReplayModule::statistics, this, boost::asio::placeholders::error));
+}
+
+PcapReplayModule::~PcapReplayModule() {
+	timer.cancel();
+	timer_statistics.cancel();
+}
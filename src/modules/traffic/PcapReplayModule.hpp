@@ -0,0 +1,83 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PCAP_REPLAY_MODULE_HPP
+#define PCAP_REPLAY_MODULE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <boost/asio.hpp>
+
+#include "../Module.hpp"
+#include "../../utils/CaptureFile.hpp"
+#include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
+
+// Injects the frames of a pcap or pcapng file into the graph, either with
+// the original inter-packet timing, scaled by a speed-up factor or as fast
+// as possible
+class PcapReplayModule : public Module {
+	public:
+		PcapReplayModule(boost::asio::io_service &io_service, const std::string &captures_path);
+		PcapReplayModule(boost::asio::io_service &io_service) : PcapReplayModule(io_service, "config/captures") {};
+		~PcapReplayModule();
+
+		const char* getType() const {
+			return "pcap_replay";
+		}
+
+	private:
+		boost::asio::io_service &io_service;
+
+		SendingPort<PacketRef> output_port;
+
+		ParameterStringSelect parameter_capture_filename = {"", {}};
+		ParameterStringSelect parameter_timing = {"original", {"original", "speedup", "maximum"}};
+		ParameterDouble parameter_speedup = {2, 0.01, std::numeric_limits<double>::quiet_NaN(), 0.5};
+		ParameterBool parameter_loop = true;
+		Statistic statistic_packets;
+
+		void listCaptures(const std::string &path);
+		void loadCapture(const std::string &capture_filename);
+
+		std::unique_ptr<CaptureFile> capture;
+		CaptureFile::Record record;
+		bool record_pending = false;
+
+		// The first record after loading, looping or a change of the timing
+		// is sent immediately and serves as reference for the following ones
+		std::atomic<bool> synchronize = {true};
+		std::chrono::high_resolution_clock::time_point start_time_point;
+		std::chrono::nanoseconds capture_start_time;
+
+		WheelTimer timer;
+		void process(const boost::system::error_code& error);
+
+		uint64_t packets = 0;
+
+		WheelTimer timer_statistics;
+		void statistics(const boost::system::error_code& error);
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TrafficGeneratorModule.hpp"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+using namespace std;
+
+// Upper bound of packets generated at once, so that other handlers still run
+static constexpr size_t burst_size = 256;
+
+// Generation restarts from the current time if it has fallen behind by more
+// than this, instead of trying to catch up
+static constexpr chrono::seconds backlog_limit(1);
+
+static constexpr size_t ethernet_header_length = 14;
+static constexpr size_t ipv4_header_length = 20;
+static constexpr size_t udp_header_length = 8;
+static constexpr uint16_t udp_source_port_base = 10000;
+static constexpr uint16_t udp_destination_port = 9;
+
+TrafficGeneratorModule::TrafficGeneratorModule(boost::asio::io_service &io_service) : timer(io_service), generator(random_device{}()), distribution(1.0), timer_statistics(io_service) {
+	setName("Traffic Generator");
+	addPort({"out", "Out", PortInfo::Side::right, &output_port});
+	addParameter({"pattern", "Pattern", "", &parameter_pattern});
+	addParameter({"bitrate", "Bitrate", "bit/s", &parameter_bitrate});
+	addParameter({"packet_size", "Packet Size", "bytes", &parameter_packet_size});
+	addParameter({"flows", "Flows", "", &parameter_flows});
+	addParameter({"on_time", "On Time", "ms", &parameter_on_time});
+	addParameter({"off_time", "Off Time", "ms", &parameter_off_time});
+	addStatistic({"packets", "Packets Sent", "", &statistic_packets});
+
+	start_time_point = chrono::high_resolution_clock::now();
+	next_time_point = start_time_point;
+
+	timer.expires_at(next_time_point);
+	timer.async_wait(boost::bind(&TrafficGeneratorModule::process, this, boost::asio::placeholders::error));
+
+	// Start statistics timer
+	timer_statistics.expires_from_now(chrono::milliseconds(0));
+	timer_statistics.async_wait(boost::bind(&TrafficGeneratorModule::statistics, this, boost::asio::placeholders::error));
+}
+
+void TrafficGeneratorModule::process(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	const auto now = chrono::high_resolution_clock::now();
+
+	// Check again later if generation is disabled
+	if(parameter_bitrate.get() <= 0) {
+		next_time_point = now;
+		timer.expires_at(now + chrono::milliseconds(100));
+		timer.async_wait(boost::bind(&TrafficGeneratorModule::process, this, boost::asio::placeholders::error));
+		return;
+	}
+
+	if(now - next_time_point > backlog_limit) {
+		next_time_point = now;
+	}
+
+	const string pattern = parameter_pattern.get();
+	const size_t packet_size = parameter_packet_size.get();
+	const size_t flows = parameter_flows.get();
+	const double interval = packet_size * 8 / parameter_bitrate.get();
+
+	vector<uint8_t> frame = createFrame(packet_size);
+	const size_t udp_offset = ethernet_header_length + ipv4_header_length;
+
+	for(size_t i = 0; i < burst_size && next_time_point <= now; ++i) {
+		// Flows differ in their UDP source port, every packet carries a
+		// sequence number as payload
+		const uint16_t source_port = udp_source_port_base + sequence_number % flows;
+		frame[udp_offset] = source_port >> 8;
+		frame[udp_offset+1] = source_port;
+		for(size_t j = 0; j < 8 && udp_offset + udp_header_length + j < frame.size(); ++j) {
+			frame[udp_offset + udp_header_length + j] = sequence_number >> (56 - 8 * j);
+		}
+
+		sequence_number++;
+		packets++;
+		output_port.send(Packet::create(frame));
+
+		next_time_point = getNextTimePoint(next_time_point, pattern, interval);
+	}
+
+	timer.expires_at(max(next_time_point, now));
+	timer.async_wait(boost::bind(&TrafficGeneratorModule::process, this, boost::asio::placeholders::error));
+}
+
+chrono::high_resolution_clock::time_point TrafficGeneratorModule::getNextTimePoint(chrono::high_resolution_clock::time_point time_point, const string &pattern, double interval) {
+	// Poisson traffic has exponentially distributed inter-arrival times
+	if(pattern == "poisson") {
+		interval *= distribution(generator);
+	}
+	time_point += chrono::duration_cast<chrono::high_resolution_clock::duration>(chrono::duration<double>(interval));
+
+	// Packets are only sent during the on periods with the rate of the
+	// on periods
+	if(pattern == "on_off") {
+		const auto on_time = chrono::duration_cast<chrono::high_resolution_clock::duration>(chrono::duration<double, milli>(parameter_on_time.get()));
+		const auto off_time = chrono::duration_cast<chrono::high_resolution_clock::duration>(chrono::duration<double, milli>(parameter_off_time.get()));
+		const auto position = (time_point - start_time_point) % (on_time + off_time);
+		if(position >= on_time) {
+			time_point += on_time + off_time - position;
+		}
+	}
+
+	return time_point;
+}
+
+vector<uint8_t> TrafficGeneratorModule::createFrame(size_t packet_size) {
+	vector<uint8_t> bytes(max(packet_size, ethernet_header_length + ipv4_header_length + udp_header_length), 0);
+
+	// Ethernet header with locally administered addresses
+	const uint8_t destination_address[] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+	const uint8_t source_address[] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+	copy(begin(destination_address), end(destination_address), bytes.begin());
+	copy(begin(source_address), end(source_address), bytes.begin() + 6);
+	bytes[12] = 0x08;
+	bytes[13] = 0x00;
+
+	// IPv4 header from 10.0.1.1 to 10.0.2.1
+	const size_t ip_offset = ethernet_header_length;
+	const uint16_t total_length = bytes.size() - ethernet_header_length;
+	bytes[ip_offset] = 0x45;
+	bytes[ip_offset+2] = total_length >> 8;
+	bytes[ip_offset+3] = total_length;
+	bytes[ip_offset+6] = 0x40;
+	bytes[ip_offset+8] = 64;
+	bytes[ip_offset+9] = 17;
+	bytes[ip_offset+12] = 10;
+	bytes[ip_offset+14] = 1;
+	bytes[ip_offset+15] = 1;
+	bytes[ip_offset+16] = 10;
+	bytes[ip_offset+18] = 2;
+	bytes[ip_offset+19] = 1;
+
+	// UDP header without checksum
+	const size_t udp_offset = ip_offset + ipv4_header_length;
+	const uint16_t udp_length = total_length - ipv4_header_length;
+	bytes[udp_offset+2] = udp_destination_port >> 8;
+	bytes[udp_offset+3] = udp_destination_port;
+	bytes[udp_offset+4] = udp_length >> 8;
+	bytes[udp_offset+5] = udp_length;
+
+	Packet packet(bytes);
+	packet.updateIPv4HeaderChecksum();
+
+	return vector<uint8_t>(packet.getBytes().begin(), packet.getBytes().end());
+}
+
+void TrafficGeneratorModule::statistics(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	statistic_packets.set(packets);
+
+	timer_statistics.expires_at(timer_statistics.expiry() + chrono::milliseconds(1000));
+	timer_statistics.async_wait(boost::bind(&TrafficGeneratorModule::statistics, this, boost::asio::placeholders::error));
+}
+
+TrafficGeneratorModule::~TrafficGeneratorModule() {
+	timer.cancel();
+	timer_statistics.cancel();
+}
@@ -0,0 +1,78 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRAFFIC_GENERATOR_MODULE_HPP
+#define TRAFFIC_GENERATOR_MODULE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "../Module.hpp"
+#include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
+
+// Generates UDP packets without any network interface, so that the packet
+// processing capacity of a graph can be measured in a single process
+class TrafficGeneratorModule : public Module {
+	public:
+		TrafficGeneratorModule(boost::asio::io_service &io_service);
+		~TrafficGeneratorModule();
+
+		const char* getType() const {
+			return "traffic_generator";
+		}
+
+	private:
+		SendingPort<PacketRef> output_port;
+
+		ParameterStringSelect parameter_pattern = {"cbr", {"cbr", "poisson", "on_off"}};
+		ParameterDouble parameter_bitrate = {0, 0, std::numeric_limits<double>::quiet_NaN(), 1000};
+		ParameterDouble parameter_packet_size = {1500, 64, 65535, 1};
+		ParameterDouble parameter_flows = {1, 1, 65535, 1};
+		ParameterDouble parameter_on_time = {100, 1, std::numeric_limits<double>::quiet_NaN(), 10};
+		ParameterDouble parameter_off_time = {100, 0, std::numeric_limits<double>::quiet_NaN(), 10};
+		Statistic statistic_packets;
+
+		WheelTimer timer;
+		void process(const boost::system::error_code& error);
+
+		std::chrono::high_resolution_clock::time_point start_time_point;
+		std::chrono::high_resolution_clock::time_point next_time_point;
+		std::chrono::high_resolution_clock::time_point getNextTimePoint(std::chrono::high_resolution_clock::time_point time_point, const std::string &pattern, double interval);
+
+		std::mt19937 generator;
+		std::exponential_distribution<double> distribution;
+
+		std::vector<uint8_t> createFrame(size_t packet_size);
+		uint64_t sequence_number = 0;
+		uint64_t packets = 0;
+
+		WheelTimer timer_statistics;
+		void statistics(const boost::system::error_code& error);
+};
+
+#endif
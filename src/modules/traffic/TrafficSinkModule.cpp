@@ -0,0 +1,87 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TrafficSinkModule.hpp"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+using namespace std;
+
+TrafficSinkModule::TrafficSinkModule(boost::asio::io_service &io_service) : timer(io_service) {
+	setName("Traffic Sink");
+	addPort({"in", "In", PortInfo::Side::left, &input_port});
+	addParameter({"interval", "Interval", "ms", &parameter_interval});
+	addStatistic({"packets", "Packets Received", "", &statistic_packets});
+	addStatistic({"packets_per_second", "Packets", "packets/s", &statistic_packets_per_second});
+	addStatistic({"bits_per_second", "Bits", "bit/s", &statistic_bits_per_second});
+	addStatistic({"delay_mean", "Mean Delay", "ms", &statistic_delay_mean});
+	addStatistic({"delay_max", "Max. Delay", "ms", &statistic_delay_max});
+
+	input_port.setReceiveHandler<&TrafficSinkModule::receive>(this);
+
+	interval_start = chrono::high_resolution_clock::now();
+	timer.expires_at(interval_start + chrono::milliseconds((uint64_t) parameter_interval.get()));
+	timer.async_wait(boost::bind(&TrafficSinkModule::process, this, boost::asio::placeholders::error));
+}
+
+void TrafficSinkModule::receive(PacketRef packet) {
+	const auto delay = chrono::high_resolution_clock::now() - packet->getCreationTimePoint();
+
+	packets++;
+	interval_packets++;
+	interval_bytes += packet->getBytes().size();
+	interval_delay_sum += delay;
+	interval_delay_max = max(interval_delay_max, delay);
+}
+
+void TrafficSinkModule::process(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	const auto now = chrono::high_resolution_clock::now();
+	const double interval_seconds = chrono::duration<double>(now - interval_start).count();
+
+	statistic_packets.set(packets);
+	statistic_packets_per_second.set(interval_packets / interval_seconds);
+	statistic_bits_per_second.set(interval_bytes * 8 / interval_seconds);
+	if(interval_packets != 0) {
+		statistic_delay_mean.set(chrono::duration<double, milli>(interval_delay_sum).count() / interval_packets);
+	} else {
+		statistic_delay_mean.set(0);
+	}
+	statistic_delay_max.set(chrono::duration<double, milli>(interval_delay_max).count());
+
+	interval_packets = 0;
+	interval_bytes = 0;
+	interval_delay_sum = {};
+	interval_delay_max = {};
+	interval_start = now;
+
+	timer.expires_at(timer.expiry() + chrono::milliseconds((uint64_t) parameter_interval.get()));
+	timer.async_wait(boost::bind(&TrafficSinkModule::process, this, boost::asio::placeholders::error));
+}
+
+TrafficSinkModule::~TrafficSinkModule() {
+	timer.cancel();
+}
@@ -0,0 +1,68 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRAFFIC_SINK_MODULE_HPP
+#define TRAFFIC_SINK_MODULE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include <boost/asio.hpp>
+
+#include "../Module.hpp"
+#include "../../utils/Packet.hpp"
+#include "../../utils/TimerWheel.hpp"
+
+// Counts and discards packets, e.g. those of a traffic generator
+class TrafficSinkModule : public Module {
+	public:
+		TrafficSinkModule(boost::asio::io_service &io_service);
+		~TrafficSinkModule();
+
+		const char* getType() const {
+			return "traffic_sink";
+		}
+
+	private:
+		ReceivingPort<PacketRef> input_port;
+
+		ParameterDouble parameter_interval = {1000, 1, std::numeric_limits<double>::quiet_NaN(), 100};
+		Statistic statistic_packets;
+		Statistic statistic_packets_per_second;
+		Statistic statistic_bits_per_second;
+		Statistic statistic_delay_mean;
+		Statistic statistic_delay_max;
+
+		void receive(PacketRef packet);
+
+		uint64_t packets = 0;
+		uint64_t interval_packets = 0;
+		uint64_t interval_bytes = 0;
+		std::chrono::high_resolution_clock::duration interval_delay_sum = {};
+		std::chrono::high_resolution_clock::duration interval_delay_max = {};
+
+		WheelTimer timer;
+		std::chrono::high_resolution_clock::time_point interval_start;
+		void process(const boost::system::error_code& error);
+};
+
+#endif
@@ -0,0 +1,242 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: https://www.kernel.org/doc/html/latest/networking/filter.html
+
+#include "BpfFilter.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+#ifdef HAVE_PCAP
+#include <pcap/pcap.h>
+#endif
+
+using namespace std;
+
+BpfFilter::BpfFilter(const string &expression) {
+	if(expression.find_first_not_of("0123456789 \t\r\n,") == string::npos) {
+		parse(expression);
+	} else {
+		compile(expression);
+	}
+
+	validate();
+}
+
+const vector<sock_filter>& BpfFilter::getProgram() const {
+	return program;
+}
+
+void BpfFilter::parse(const string &expression) {
+	string numbers = expression;
+	for(auto &c : numbers) {
+		if(c == ',') {
+			c = '\n';
+		}
+	}
+
+	istringstream stream(numbers);
+	size_t length;
+	if(!(stream >> length)) {
+		throw runtime_error("Missing program length");
+	}
+
+	for(size_t i = 0; i < length; ++i) {
+		uint32_t code, jt, jf, k;
+		if(!(stream >> code >> jt >> jf >> k)) {
+			throw runtime_error("Program is shorter than its length");
+		}
+
+		program.push_back({(uint16_t) code, (uint8_t) jt, (uint8_t) jf, k});
+	}
+}
+
+void BpfFilter::compile(const string &expression) {
+#ifdef HAVE_PCAP
+	pcap_t *pcap = pcap_open_dead(DLT_EN10MB, 65535);
+	if(pcap == nullptr) {
+		throw runtime_error("Cannot initialize libpcap");
+	}
+
+	bpf_program bpf_program;
+	if(pcap_compile(pcap, &bpf_program, expression.c_str(), 1, PCAP_NETMASK_UNKNOWN) < 0) {
+		const string error = pcap_geterr(pcap);
+		pcap_close(pcap);
+		throw runtime_error(error);
+	}
+
+	for(u_int i = 0; i < bpf_program.bf_len; ++i) {
+		const bpf_insn &insn = bpf_program.bf_insns[i];
+		program.push_back({insn.code, insn.jt, insn.jf, insn.k});
+	}
+
+	pcap_freecode(&bpf_program);
+	pcap_close(pcap);
+#else
+	throw runtime_error("Filter expressions require libpcap, use the format of tcpdump -ddd instead");
+#endif
+}
+
+void BpfFilter::validate() const {
+	// The userspace interpreter relies on the same guarantees as the kernel:
+	// all jumps lead forward and stay within the program, which ends with a
+	// return instruction
+	if(program.empty() || program.size() > BPF_MAXINSNS) {
+		throw runtime_error("Invalid program length");
+	}
+
+	for(size_t pc = 0; pc < program.size(); ++pc) {
+		const sock_filter &insn = program[pc];
+		const size_t remaining = program.size() - pc - 1;
+
+		switch(BPF_CLASS(insn.code)) {
+			case BPF_LD:
+			case BPF_LDX:
+				if(BPF_MODE(insn.code) == BPF_MEM && insn.k >= BPF_MEMWORDS) {
+					throw runtime_error("Invalid memory index");
+				}
+				break;
+			case BPF_ST:
+			case BPF_STX:
+				if(insn.k >= BPF_MEMWORDS) {
+					throw runtime_error("Invalid memory index");
+				}
+				break;
+			case BPF_ALU:
+				if((BPF_OP(insn.code) == BPF_DIV || BPF_OP(insn.code) == BPF_MOD) && BPF_SRC(insn.code) == BPF_K && insn.k == 0) {
+					throw runtime_error("Division by zero");
+				}
+				break;
+			case BPF_JMP:
+				if(BPF_OP(insn.code) == BPF_JA) {
+					if(insn.k >= remaining) {
+						throw runtime_error("Jump out of program");
+					}
+				} else if(insn.jt >= remaining || insn.jf >= remaining) {
+					throw runtime_error("Jump out of program");
+				}
+				break;
+		}
+	}
+
+	if(BPF_CLASS(program.back().code) != BPF_RET) {
+		throw runtime_error("Program does not end with a return instruction");
+	}
+}
+
+bool BpfFilter::match(const uint8_t *data, size_t size) const {
+	uint32_t a = 0;
+	uint32_t x = 0;
+	uint32_t mem[BPF_MEMWORDS] = {};
+
+	// Out of bounds loads end the program without a match like in the kernel
+	auto load = [&](uint64_t offset, size_t length, uint32_t &value) {
+		if(offset + length > size) {
+			return false;
+		}
+
+		value = 0;
+		for(size_t i = 0; i < length; ++i) {
+			value = (value << 8) | data[offset + i];
+		}
+
+		return true;
+	};
+
+	auto loadSize = [](uint16_t code) -> size_t {
+		switch(BPF_SIZE(code)) {
+			case BPF_W: return 4;
+			case BPF_H: return 2;
+			default: return 1;
+		}
+	};
+
+	for(size_t pc = 0; pc < program.size(); ++pc) {
+		const sock_filter &insn = program[pc];
+		const uint32_t src = (BPF_SRC(insn.code) == BPF_X) ? x : insn.k;
+
+		switch(BPF_CLASS(insn.code)) {
+			case BPF_LD:
+				switch(BPF_MODE(insn.code)) {
+					case BPF_IMM: a = insn.k; break;
+					case BPF_ABS: if(!load(insn.k, loadSize(insn.code), a)) {return false;} break;
+					case BPF_IND: if(!load((uint64_t) x + insn.k, loadSize(insn.code), a)) {return false;} break;
+					case BPF_MEM: a = mem[insn.k]; break;
+					case BPF_LEN: a = size; break;
+					default: return false;
+				}
+				break;
+			case BPF_LDX:
+				switch(BPF_MODE(insn.code)) {
+					case BPF_IMM: x = insn.k; break;
+					case BPF_MEM: x = mem[insn.k]; break;
+					case BPF_LEN: x = size; break;
+					case BPF_MSH: if(!load(insn.k, 1, x)) {return false;} x = (x & 0xf) << 2; break;
+					default: return false;
+				}
+				break;
+			case BPF_ST:
+				mem[insn.k] = a;
+				break;
+			case BPF_STX:
+				mem[insn.k] = x;
+				break;
+			case BPF_ALU:
+				switch(BPF_OP(insn.code)) {
+					case BPF_ADD: a += src; break;
+					case BPF_SUB: a -= src; break;
+					case BPF_MUL: a *= src; break;
+					case BPF_DIV: if(src == 0) {return false;} a /= src; break;
+					case BPF_MOD: if(src == 0) {return false;} a %= src; break;
+					case BPF_OR: a |= src; break;
+					case BPF_AND: a &= src; break;
+					case BPF_XOR: a ^= src; break;
+					case BPF_LSH: a = (src < 32) ? (a << src) : 0; break;
+					case BPF_RSH: a = (src < 32) ? (a >> src) : 0; break;
+					case BPF_NEG: a = -a; break;
+					default: return false;
+				}
+				break;
+			case BPF_JMP:
+				switch(BPF_OP(insn.code)) {
+					case BPF_JA: pc += insn.k; break;
+					case BPF_JEQ: pc += (a == src) ? insn.jt : insn.jf; break;
+					case BPF_JGT: pc += (a > src) ? insn.jt : insn.jf; break;
+					case BPF_JGE: pc += (a >= src) ? insn.jt : insn.jf; break;
+					case BPF_JSET: pc += (a & src) ? insn.jt : insn.jf; break;
+					default: return false;
+				}
+				break;
+			case BPF_RET:
+				return ((BPF_RVAL(insn.code) == BPF_A) ? a : insn.k) != 0;
+			case BPF_MISC:
+				if(BPF_MISCOP(insn.code) == BPF_TAX) {
+					x = a;
+				} else {
+					a = x;
+				}
+				break;
+		}
+	}
+
+	return false;
+}
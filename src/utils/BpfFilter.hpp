@@ -0,0 +1,53 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: https://www.kernel.org/doc/html/latest/networking/filter.html
+
+#ifndef BPF_FILTER_HPP
+#define BPF_FILTER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <linux/filter.h>
+
+// Classic BPF program that can be attached to a socket or run in userspace.
+// Expressions are compiled with libpcap if available. Otherwise, and in any
+// case if the expression only consists of numbers, it is read in the format
+// of tcpdump -ddd, where the lines may also be separated by commas.
+class BpfFilter {
+	public:
+		BpfFilter(const std::string &expression);
+
+		const std::vector<sock_filter>& getProgram() const;
+
+		bool match(const uint8_t *data, size_t size) const;
+
+	private:
+		std::vector<sock_filter> program;
+
+		void parse(const std::string &expression);
+		void compile(const std::string &expression);
+		void validate() const;
+};
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: https://www.ietf.org/archive/id/draft-ietf-opsawg-pcap-03.html
+// Reference: https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-00.html
+
+#include "CaptureFile.hpp"
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static constexpr uint32_t pcap_magic_us = 0xA1B2C3D4;
+static constexpr uint32_t pcap_magic_ns = 0xA1B23C4D;
+static constexpr uint32_t pcapng_section_header_block = 0x0A0D0D0A;
+static constexpr uint32_t pcapng_byte_order_magic = 0x1A2B3C4D;
+static constexpr uint32_t pcapng_interface_description_block = 0x00000001;
+static constexpr uint32_t pcapng_simple_packet_block = 0x00000003;
+static constexpr uint32_t pcapng_enhanced_packet_block = 0x00000006;
+static constexpr uint16_t pcapng_option_if_tsresol = 9;
+static constexpr uint16_t link_type_ethernet = 1;
+
+// The kernel is asked to read this far ahead of the current position
+static constexpr size_t prefetch_window = 16 * 1024 * 1024;
+
+CaptureFile::CaptureFile(const string &filename) {
+	const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0) {
+		throw runtime_error("Cannot open capture file " + filename + ": " + strerror(errno));
+	}
+
+	struct stat file_stat;
+	if(fstat(fd, &file_stat) < 0 || file_stat.st_size < 24) {
+		::close(fd);
+		throw runtime_error("Invalid capture file " + filename);
+	}
+	size = file_stat.st_size;
+
+	void *file_mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(file_mapping == MAP_FAILED) {
+		throw runtime_error("Cannot map capture file " + filename + ": " + strerror(errno));
+	}
+	mapping = static_cast<uint8_t*>(file_mapping);
+	madvise(mapping, size, MADV_SEQUENTIAL);
+
+	// Detect format and byte order
+	uint32_t magic;
+	memcpy(&magic, mapping, sizeof(magic));
+	if(magic == pcapng_section_header_block) {
+		format = Format::pcapng;
+	} else if(magic == pcap_magic_us || magic == pcap_magic_ns || __builtin_bswap32(magic) == pcap_magic_us || __builtin_bswap32(magic) == pcap_magic_ns) {
+		format = Format::pcap;
+		swapped = (magic != pcap_magic_us && magic != pcap_magic_ns);
+		timestamp_resolution = (read32(0) == pcap_magic_ns) ? 1 : 1000;
+
+		if((read32(20) & 0x0FFFFFFF) != link_type_ethernet) {
+			munmap(mapping, size);
+			throw runtime_error("Capture file " + filename + " does not contain Ethernet frames");
+		}
+
+		data_offset = 24;
+	} else {
+		munmap(mapping, size);
+		throw runtime_error("Unknown format of capture file " + filename);
+	}
+
+	rewind();
+}
+
+CaptureFile::~CaptureFile() {
+	munmap(mapping, size);
+}
+
+uint32_t CaptureFile::read32(size_t position) const {
+	uint32_t value;
+	memcpy(&value, mapping + position, sizeof(value));
+
+	return swapped ? __builtin_bswap32(value) : value;
+}
+
+uint16_t CaptureFile::read16(size_t position) const {
+	uint16_t value;
+	memcpy(&value, mapping + position, sizeof(value));
+
+	return swapped ? __builtin_bswap16(value) : value;
+}
+
+void CaptureFile::rewind() {
+	offset = (format == Format::pcap) ? data_offset : 0;
+	prefetch_offset = offset;
+	interface_resolutions.clear();
+
+	prefetch();
+}
+
+void CaptureFile::prefetch() {
+	// Keep a window of half its size ahead of the current position in the
+	// page cache, so that reading never waits for the disk
+	if(prefetch_offset >= size || prefetch_offset > offset + prefetch_window / 2) {
+		return;
+	}
+
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	const size_t start = prefetch_offset & ~(page_size - 1);
+	const size_t end = min(size, offset + prefetch_window);
+	if(end > start) {
+		madvise(mapping + start, end - start, MADV_WILLNEED);
+	}
+	prefetch_offset = end;
+}
+
+bool CaptureFile::next(Record &record) {
+	prefetch();
+
+	if(format == Format::pcap) {
+		return nextPcap(record);
+	}
+
+	return nextPcapng(record);
+}
+
+bool CaptureFile::nextPcap(Record &record) {
+	if(offset + 16 > size) {
+		return false;
+	}
+
+	const uint64_t seconds = read32(offset);
+	const uint64_t fraction = read32(offset + 4);
+	const size_t captured_length = read32(offset + 8);
+	if(offset + 16 + captured_length > size) {
+		return false;
+	}
+
+	record.data = mapping + offset + 16;
+	record.size = captured_length;
+	record.timestamp = chrono::nanoseconds(seconds * 1000000000 + fraction * timestamp_resolution);
+
+	offset += 16 + captured_length;
+
+	return true;
+}
+
+bool CaptureFile::nextPcapng(Record &record) {
+	while(offset + 12 <= size) {
+		// Byte order is given by every section header
+		uint32_t block_type;
+		memcpy(&block_type, mapping + offset, sizeof(block_type));
+		if(block_type == pcapng_section_header_block) {
+			uint32_t byte_order_magic;
+			memcpy(&byte_order_magic, mapping + offset + 8, sizeof(byte_order_magic));
+			swapped = (byte_order_magic != pcapng_byte_order_magic);
+			interface_resolutions.clear();
+		} else {
+			block_type = swapped ? __builtin_bswap32(block_type) : block_type;
+		}
+
+		const size_t block_offset = offset;
+		const size_t block_length = read32(offset + 4);
+		if(block_length < 12 || block_offset + block_length > size) {
+			return false;
+		}
+		offset += block_length;
+
+		if(block_type == pcapng_interface_description_block) {
+			parseInterfaceDescription(block_offset, block_length);
+		} else if(block_type == pcapng_enhanced_packet_block && block_length >= 32) {
+			const uint32_t interface_id = read32(block_offset + 8);
+			if(interface_id >= interface_resolutions.size() || interface_resolutions[interface_id] <= 0) {
+				// Interface with another link type
+				continue;
+			}
+
+			const uint64_t timestamp = ((uint64_t) read32(block_offset + 12) << 32) | read32(block_offset + 16);
+			record.data = mapping + block_offset + 28;
+			record.size = min((size_t) read32(block_offset + 20), block_length - 32);
+			record.timestamp = chrono::nanoseconds((uint64_t) (timestamp * interface_resolutions[interface_id]));
+
+			return true;
+		} else if(block_type == pcapng_simple_packet_block && block_length >= 16) {
+			if(interface_resolutions.empty() || interface_resolutions[0] <= 0) {
+				continue;
+			}
+
+			// Simple packet blocks do not have a timestamp
+			record.data = mapping + block_offset + 12;
+			record.size = min((size_t) read32(block_offset + 8), block_length - 16);
+			record.timestamp = chrono::nanoseconds(0);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void CaptureFile::parseInterfaceDescription(size_t block_offset, size_t block_length) {
+	// Interfaces with other link types are marked with a resolution of zero
+	if(block_length < 20 || read16(block_offset + 8) != link_type_ethernet) {
+		interface_resolutions.push_back(0);
+		return;
+	}
+
+	double resolution = 1000;
+
+	// Options follow the fixed part of the block
+	size_t option_offset = block_offset + 16;
+	const size_t options_end = block_offset + block_length - 4;
+	while(option_offset + 4 <= options_end) {
+		const uint16_t code = read16(option_offset);
+		const uint16_t length = read16(option_offset + 2);
+		if(code == 0 || option_offset + 4 + length > options_end) {
+			break;
+		}
+
+		if(code == pcapng_option_if_tsresol && length >= 1) {
+			const uint8_t tsresol = mapping[option_offset + 4];
+			if(tsresol & 0x80) {
+				resolution = 1e9 / pow(2.0, tsresol & 0x7F);
+			} else {
+				resolution = 1e9 / pow(10.0, tsresol);
+			}
+		}
+
+		option_offset += 4 + ((length + 3) & ~3);
+	}
+
+	interface_resolutions.push_back(resolution);
+}
@@ -0,0 +1,78 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: https://www.ietf.org/archive/id/draft-ietf-opsawg-pcap-03.html
+// Reference: https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-00.html
+
+#ifndef CAPTURE_FILE_HPP
+#define CAPTURE_FILE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sequential reader of pcap and pcapng files with Ethernet link type. The
+// file is memory mapped and read ahead in the background, so records can be
+// handed out without copying or system calls.
+class CaptureFile {
+	public:
+		struct Record {
+			const uint8_t *data;
+			size_t size;
+			std::chrono::nanoseconds timestamp;
+		};
+
+		CaptureFile(const std::string &filename);
+		~CaptureFile();
+
+		CaptureFile(const CaptureFile&) = delete;
+		CaptureFile& operator=(const CaptureFile&) = delete;
+
+		// Returns false at the end of the file
+		bool next(Record &record);
+		void rewind();
+
+	private:
+		uint8_t *mapping = nullptr;
+		size_t size = 0;
+		size_t offset = 0;
+		size_t prefetch_offset = 0;
+		void prefetch();
+
+		enum class Format {pcap, pcapng};
+		Format format;
+		bool swapped = false;
+		uint32_t read32(size_t position) const;
+		uint16_t read16(size_t position) const;
+
+		// pcap
+		uint64_t timestamp_resolution = 1000;
+		size_t data_offset = 0;
+		bool nextPcap(Record &record);
+
+		// pcapng, timestamp resolution in ns per tick for every interface
+		std::vector<double> interface_resolutions;
+		bool nextPcapng(Record &record);
+		void parseInterfaceDescription(size_t block_offset, size_t block_length);
+};
+
+#endif
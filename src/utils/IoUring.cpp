@@ -0,0 +1,440 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "IoUring.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <boost/bind.hpp>
+
+using namespace std;
+
+boost::asio::io_service::id IoUring::id;
+
+static int io_uring_setup(unsigned int entries, io_uring_params *params) {
+	return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+	return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int io_uring_register(int ring_fd, unsigned int opcode, void *arg, unsigned int nr_args) {
+	return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+IoUring::IoUring(boost::asio::io_service &io_service) : boost::asio::io_service::service(io_service), io_service(io_service), eventfd_descriptor(io_service) {
+	ring_fd = io_uring_setup(4096, &params);
+	if(ring_fd < 0) {
+		cerr << "Cannot set up io_uring: " << strerror(errno) << "! Falling back to epoll." << endl;
+		return;
+	}
+
+	sq_mapping_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cq_mapping_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		sq_mapping_size = max(sq_mapping_size, cq_mapping_size);
+		cq_mapping_size = sq_mapping_size;
+	}
+
+	sq_mapping = mmap(nullptr, sq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+	if(sq_mapping == MAP_FAILED) {
+		sq_mapping = nullptr;
+		cerr << "Cannot map io_uring: " << strerror(errno) << "! Falling back to epoll." << endl;
+		close();
+		return;
+	}
+
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		cq_mapping = sq_mapping;
+	} else {
+		cq_mapping = mmap(nullptr, cq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+		if(cq_mapping == MAP_FAILED) {
+			cq_mapping = nullptr;
+			cerr << "Cannot map io_uring: " << strerror(errno) << "! Falling back to epoll." << endl;
+			close();
+			return;
+		}
+	}
+
+	sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	void *sqes_mapping = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+	if(sqes_mapping == MAP_FAILED) {
+		cerr << "Cannot map io_uring: " << strerror(errno) << "! Falling back to epoll." << endl;
+		close();
+		return;
+	}
+	sqes = static_cast<io_uring_sqe*>(sqes_mapping);
+
+	uint8_t *sq_base = static_cast<uint8_t*>(sq_mapping);
+	sq_head = reinterpret_cast<uint32_t*>(sq_base + params.sq_off.head);
+	sq_tail = reinterpret_cast<uint32_t*>(sq_base + params.sq_off.tail);
+	sq_mask = *reinterpret_cast<uint32_t*>(sq_base + params.sq_off.ring_mask);
+	sq_array = reinterpret_cast<uint32_t*>(sq_base + params.sq_off.array);
+	sq_tail_local = *sq_tail;
+	sq_submitted = sq_tail_local;
+
+	uint8_t *cq_base = static_cast<uint8_t*>(cq_mapping);
+	cq_head = reinterpret_cast<uint32_t*>(cq_base + params.cq_off.head);
+	cq_tail = reinterpret_cast<uint32_t*>(cq_base + params.cq_off.tail);
+	cq_mask = *reinterpret_cast<uint32_t*>(cq_base + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe*>(cq_base + params.cq_off.cqes);
+
+	// Completions wake up the I/O service through an eventfd
+	int event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(event_fd < 0 || io_uring_register(ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1) < 0) {
+		cerr << "Cannot register eventfd with io_uring: " << strerror(errno) << "! Falling back to epoll." << endl;
+		if(event_fd >= 0) {
+			::close(event_fd);
+		}
+		close();
+		return;
+	}
+	eventfd_descriptor.assign(event_fd);
+
+	startWait();
+}
+
+bool IoUring::isReady() const {
+	return ring_fd >= 0 && eventfd_descriptor.is_open();
+}
+
+int IoUring::addBufferGroup(uint16_t buffers, size_t buffer_size) {
+	if(!isReady()) {
+		return -1;
+	}
+
+	uint32_t entries = 1;
+	while(entries < buffers) {
+		entries <<= 1;
+	}
+
+	const int group = next_buffer_group++;
+
+	BufferGroup buffer_group;
+	buffer_group.ring_size = entries * sizeof(io_uring_buf);
+	// The pages have to exist before they are registered, otherwise the
+	// kernel might pin the shared zero page
+	void *mapping = mmap(nullptr, buffer_group.ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if(mapping == MAP_FAILED) {
+		cerr << "Cannot allocate io_uring buffer ring: " << strerror(errno) << "!" << endl;
+		return -1;
+	}
+	buffer_group.ring = static_cast<io_uring_buf_ring*>(mapping);
+	buffer_group.mask = entries - 1;
+	buffer_group.buffer_size = buffer_size;
+	buffer_group.buffers.resize(entries * buffer_size);
+
+	io_uring_buf_reg buf_reg;
+	memset(&buf_reg, 0, sizeof(buf_reg));
+	buf_reg.ring_addr = reinterpret_cast<uint64_t>(buffer_group.ring);
+	buf_reg.ring_entries = entries;
+	buf_reg.bgid = group;
+	if(io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &buf_reg, 1) < 0) {
+		cerr << "Cannot register io_uring buffer ring: " << strerror(errno) << "!" << endl;
+		munmap(buffer_group.ring, buffer_group.ring_size);
+		return -1;
+	}
+
+	buffer_groups[group] = move(buffer_group);
+	for(uint32_t i = 0; i < entries; ++i) {
+		recycleBuffer(group, i);
+	}
+
+	return group;
+}
+
+void IoUring::removeBufferGroup(int group) {
+	const auto it = buffer_groups.find(group);
+	if(it == buffer_groups.end()) {
+		return;
+	}
+
+	io_uring_buf_reg buf_reg;
+	memset(&buf_reg, 0, sizeof(buf_reg));
+	buf_reg.bgid = group;
+	io_uring_register(ring_fd, IORING_UNREGISTER_PBUF_RING, &buf_reg, 1);
+
+	munmap(it->second.ring, it->second.ring_size);
+	buffer_groups.erase(it);
+}
+
+uint8_t* IoUring::getBuffer(int group, uint16_t buffer) {
+	BufferGroup &buffer_group = buffer_groups.at(group);
+
+	return buffer_group.buffers.data() + buffer * buffer_group.buffer_size;
+}
+
+void IoUring::recycleBuffer(int group, uint16_t buffer) {
+	BufferGroup &buffer_group = buffer_groups.at(group);
+
+	// The tail overlays the reserved field of the first entry, so only the
+	// other fields of an entry are written. The entries are not accessed
+	// through bufs, as the empty struct in front of it has a size in C++.
+	const uint16_t tail = buffer_group.ring->tail;
+	io_uring_buf &buf = reinterpret_cast<io_uring_buf*>(buffer_group.ring)[tail & buffer_group.mask];
+	buf.addr = reinterpret_cast<uint64_t>(buffer_group.buffers.data() + buffer * buffer_group.buffer_size);
+	buf.len = buffer_group.buffer_size;
+	buf.bid = buffer;
+	__atomic_store_n(&buffer_group.ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+bool IoUring::receiveMultishot(int fd, int group, Handler handler) {
+	io_uring_sqe *sqe = getSqe();
+	if(sqe == nullptr) {
+		return false;
+	}
+
+	const uint64_t operation = next_operation++;
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = group;
+	sqe->user_data = operation;
+	operations[operation] = {fd, handler};
+
+	return true;
+}
+
+bool IoUring::send(int fd, const void *data, size_t size, bool link, Handler handler) {
+	io_uring_sqe *sqe = getSqe();
+	if(sqe == nullptr) {
+		return false;
+	}
+
+	const uint64_t operation = next_operation++;
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = fd;
+	if(link) {
+		sqe->flags = IOSQE_IO_HARDLINK;
+	}
+	sqe->addr = reinterpret_cast<uint64_t>(data);
+	sqe->len = size;
+	sqe->user_data = operation;
+	operations[operation] = {fd, handler};
+
+	return true;
+}
+
+void IoUring::cancel(int fd) {
+	// The data of the operations is kept until the kernel is done with it.
+	// Handlers stay in place, as one of them might be running right now.
+	bool found = false;
+	for(auto &entry : operations) {
+		if(entry.second.fd == fd) {
+			entry.second.canceled = true;
+			found = true;
+		}
+	}
+
+	if(!found) {
+		return;
+	}
+
+	io_uring_sqe *sqe = getSqe();
+	if(sqe == nullptr) {
+		return;
+	}
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = fd;
+	sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+	sqe->user_data = 0;
+
+	// The file descriptor is usually closed right afterwards
+	submit();
+}
+
+uint32_t IoUring::getSubmissionSpace() {
+	if(sq_tail_local - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries) {
+		submit();
+	}
+
+	return params.sq_entries - (sq_tail_local - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE));
+}
+
+io_uring_sqe* IoUring::getSqe() {
+	if(sq_tail_local - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries) {
+		submit();
+
+		if(sq_tail_local - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries) {
+			return nullptr;
+		}
+	}
+
+	const uint32_t index = sq_tail_local & sq_mask;
+	io_uring_sqe *sqe = &sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sq_array[index] = index;
+	sq_tail_local++;
+
+	scheduleSubmit();
+
+	return sqe;
+}
+
+void IoUring::scheduleSubmit() {
+	// Collect submissions until the current event loop turn is over
+	if(submit_pending) {
+		return;
+	}
+	submit_pending = true;
+
+	boost::asio::post(io_service, [this]() {
+		submit();
+	});
+}
+
+void IoUring::submit() {
+	submit_pending = false;
+
+	if(sq_tail_local == sq_submitted) {
+		return;
+	}
+
+	__atomic_store_n(sq_tail, sq_tail_local, __ATOMIC_RELEASE);
+
+	while(sq_tail_local != sq_submitted) {
+		const int submitted = io_uring_enter(ring_fd, sq_tail_local - sq_submitted, 0, 0);
+		if(submitted < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			// Retried with the next submission
+			if(errno != EAGAIN && errno != EBUSY) {
+				cerr << "Cannot submit to io_uring: " << strerror(errno) << "!" << endl;
+			}
+			return;
+		}
+
+		sq_submitted += submitted;
+	}
+}
+
+void IoUring::startWait() {
+	eventfd_descriptor.async_wait(boost::asio::posix::descriptor_base::wait_read,
+	                              boost::bind(&IoUring::handleWait,
+	                                          this,
+	                                          boost::asio::placeholders::error
+	                              )
+	);
+}
+
+void IoUring::handleWait(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	if(read(eventfd_descriptor.native_handle(), &eventfd_value, sizeof(eventfd_value)) < 0 && errno != EAGAIN) {
+		cerr << "Cannot read io_uring eventfd: " << strerror(errno) << "!" << endl;
+	}
+
+	reap();
+
+	startWait();
+}
+
+void IoUring::reap() {
+	uint32_t head = *cq_head;
+	while(true) {
+		const uint32_t tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+		if(head == tail) {
+			break;
+		}
+
+		while(head != tail) {
+			const io_uring_cqe cqe = cqes[head & cq_mask];
+			head++;
+			__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+			const auto it = operations.find(cqe.user_data);
+			if(it == operations.end()) {
+				continue;
+			}
+
+			// Operations are only erased here, so handlers of multishot
+			// operations can be called in place even if they start or cancel
+			// operations. Elements of the map stay where they are on insertion.
+			if(cqe.flags & IORING_CQE_F_MORE) {
+				const Operation &operation = it->second;
+				if(!operation.canceled && operation.handler) {
+					operation.handler(cqe.res, cqe.flags);
+				}
+			} else {
+				const Operation operation = move(it->second);
+				operations.erase(it);
+				if(!operation.canceled && operation.handler) {
+					operation.handler(cqe.res, cqe.flags);
+				}
+			}
+		}
+	}
+}
+
+void IoUring::shutdown() {
+	if(eventfd_descriptor.is_open()) {
+		eventfd_descriptor.cancel();
+		eventfd_descriptor.close();
+	}
+}
+
+void IoUring::close() {
+	for(const auto& entry : buffer_groups) {
+		munmap(entry.second.ring, entry.second.ring_size);
+	}
+	buffer_groups.clear();
+
+	if(sqes != nullptr) {
+		munmap(sqes, sqes_size);
+		sqes = nullptr;
+	}
+	if(cq_mapping != nullptr && cq_mapping != sq_mapping) {
+		munmap(cq_mapping, cq_mapping_size);
+	}
+	cq_mapping = nullptr;
+	if(sq_mapping != nullptr) {
+		munmap(sq_mapping, sq_mapping_size);
+		sq_mapping = nullptr;
+	}
+
+	if(ring_fd >= 0) {
+		::close(ring_fd);
+		ring_fd = -1;
+	}
+}
+
+IoUring::~IoUring() {
+	shutdown();
+
+	// Operations still in flight are completed or canceled by the kernel
+	// when the ring is closed
+	close();
+	operations.clear();
+}
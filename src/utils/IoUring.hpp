@@ -0,0 +1,133 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: https://kernel.dk/io_uring.pdf
+// Reference: https://man7.org/linux/man-pages/man7/io_uring.7.html
+
+#ifndef IO_URING_HPP
+#define IO_URING_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include <linux/io_uring.h>
+
+// Minimal io_uring that is attached to an I/O service. Submissions of one
+// event loop turn are handed to the kernel with a single system call and
+// completions are signaled through an eventfd that the I/O service waits on,
+// so handlers run on the thread of the I/O service like any other handler.
+class IoUring : public boost::asio::io_service::service {
+	public:
+		static boost::asio::io_service::id id;
+
+		typedef std::function<void(int result, uint32_t flags)> Handler;
+
+		IoUring(boost::asio::io_service &io_service);
+		~IoUring();
+
+		bool isReady() const;
+
+		// Provided buffers for multishot receives
+		int addBufferGroup(uint16_t buffers, size_t buffer_size);
+		void removeBufferGroup(int group);
+		uint8_t* getBuffer(int group, uint16_t buffer);
+		void recycleBuffer(int group, uint16_t buffer);
+
+		// Operations stay active until a completion without IORING_CQE_F_MORE
+		// arrives. The handler is released afterwards, even if the operation
+		// has been canceled, so it can keep the data of the operation alive.
+		bool receiveMultishot(int fd, int group, Handler handler);
+		// Linked sends start only after the previous one has completed,
+		// regardless of its result
+		bool send(int fd, const void *data, size_t size, bool link, Handler handler);
+
+		// Submissions that can be prepared before the queue is full
+		uint32_t getSubmissionSpace();
+
+		// Has to be called before the file descriptor is closed, no handler
+		// of its operations is called afterwards
+		void cancel(int fd);
+
+	private:
+		boost::asio::io_service &io_service;
+
+		int ring_fd = -1;
+		io_uring_params params = {};
+
+		void *sq_mapping = nullptr;
+		size_t sq_mapping_size = 0;
+		void *cq_mapping = nullptr;
+		size_t cq_mapping_size = 0;
+		io_uring_sqe *sqes = nullptr;
+		size_t sqes_size = 0;
+
+		uint32_t *sq_head = nullptr;
+		uint32_t *sq_tail = nullptr;
+		uint32_t sq_mask = 0;
+		uint32_t *sq_array = nullptr;
+		uint32_t sq_tail_local = 0;
+		uint32_t sq_submitted = 0;
+
+		uint32_t *cq_head = nullptr;
+		uint32_t *cq_tail = nullptr;
+		uint32_t cq_mask = 0;
+		io_uring_cqe *cqes = nullptr;
+
+		io_uring_sqe* getSqe();
+		bool submit_pending = false;
+		void scheduleSubmit();
+		void submit();
+
+		boost::asio::posix::stream_descriptor eventfd_descriptor;
+		uint64_t eventfd_value = 0;
+		void startWait();
+		void handleWait(const boost::system::error_code& error);
+		void reap();
+
+		struct Operation {
+			int fd;
+			Handler handler;
+			bool canceled = false;
+		};
+		std::unordered_map<uint64_t, Operation> operations;
+		uint64_t next_operation = 1; // 0 marks completions that are ignored
+
+		struct BufferGroup {
+			io_uring_buf_ring *ring;
+			size_t ring_size;
+			uint16_t mask;
+			size_t buffer_size;
+			std::vector<uint8_t> buffers;
+		};
+		std::map<int, BufferGroup> buffer_groups;
+		int next_buffer_group = 0;
+
+		void shutdown() override;
+		void close();
+};
+
+#endif
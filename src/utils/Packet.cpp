@@ -26,51 +26,230 @@
 
 using namespace std;
 
-Packet::Packet(const vector<uint8_t> &bytes) : bytes(bytes) {
+Packet::Packet(const vector<uint8_t> &bytes) : bytes(bytes.data(), bytes.size()) {
 }
 
-Packet::Packet(const uint8_t *data, size_t size) : bytes(data, data + size) {
+Packet::Packet(const uint8_t *data, size_t size) : bytes(data, size) {
+}
+
+Packet::Packet(uint8_t *data, size_t size, PacketBufferOwner &owner) : bytes(data, size, owner) {
 }
 
 void Packet::setBytes(const vector<uint8_t> &bytes) {
-	this->bytes = bytes;
+	this->bytes.assign(bytes.data(), bytes.size());
+	headers_parsed = false;
+}
+
+void Packet::setBytes(const uint8_t *data, size_t size) {
+	bytes.assign(data, size);
+	headers_parsed = false;
 }
 
-const vector<uint8_t>& Packet::getBytes() const {
+const PacketBuffer& Packet::getBytes() const {
 	return bytes;
 }
 
+void Packet::detachBytes() {
+	bytes.detach();
+}
+
+void Packet::setCreationTimePoint(const chrono::high_resolution_clock::time_point &creation_time_point) {
+	this->creation_time_point = creation_time_point;
+}
+
 const chrono::high_resolution_clock::time_point& Packet::getCreationTimePoint() const {
 	return creation_time_point;
 }
 
-size_t Packet::parseEthernetHeader(uint16_t &type_field) {
-	size_t type_field_offset = 12;
-	size_t network_layer_offset = 14;
+void Packet::setIngressTimePoint(const chrono::high_resolution_clock::time_point &ingress_time_point) {
+	this->ingress_time_point = ingress_time_point;
+}
+
+const chrono::high_resolution_clock::time_point& Packet::getIngressTimePoint() const {
+	return ingress_time_point;
+}
+
+void Packet::setDepartureTimePoint(const chrono::high_resolution_clock::time_point &departure_time_point) {
+	this->departure_time_point = departure_time_point;
+}
+
+const chrono::high_resolution_clock::time_point& Packet::getDepartureTimePoint() const {
+	return departure_time_point;
+}
 
-	// Parse type field
-	type_field = (bytes[type_field_offset] << 8) | bytes[type_field_offset+1];
+bool Packet::hasDepartureTimePoint() const {
+	return departure_time_point != chrono::high_resolution_clock::time_point();
+}
 
-	// Handle 802.1Q header
-	if(type_field == 0x8100) {
-		type_field_offset += 4;
-		network_layer_offset += 4;
+void Packet::setVnetHeader(const VnetHeader &vnet_header) {
+	this->vnet_header = vnet_header;
+}
+
+const Packet::VnetHeader& Packet::getVnetHeader() const {
+	return vnet_header;
+}
+
+Packet::Annotations& Packet::getAnnotations() {
+	return annotations;
+}
+
+const Packet::Annotations& Packet::getAnnotations() const {
+	return annotations;
+}
+
+void Packet::addHopReader() {
+	hop_readers++;
+}
 
-		type_field = (bytes[type_field_offset] << 8) | bytes[type_field_offset+1];
+void Packet::removeHopReader() {
+	hop_readers--;
+}
+
+void Packet::recordHop(const char *label) {
+	if(annotations.hop_count < Annotations::max_hops) {
+		annotations.hop_count++;
 	}
 
-	return network_layer_offset;
+	annotations.hops[annotations.hop_count-1] = {label, chrono::high_resolution_clock::now()};
 }
 
-void Packet::updateIPv4HeaderChecksum() {
-	uint16_t type_field;
-	size_t network_layer_offset = parseEthernetHeader(type_field);
+const Packet::Headers& Packet::getHeaders() const {
+	if(!headers_parsed) {
+		parseHeaders();
+	}
+
+	return headers;
+}
+
+static inline uint32_t hashBytes(uint32_t hash, const uint8_t *data, size_t size) {
+	// FNV-1a
+	for(size_t i = 0; i < size; ++i) {
+		hash = (hash ^ data[i]) * 16777619;
+	}
+
+	return hash;
+}
+
+void Packet::parseHeaders() const {
+	headers = Headers();
+	headers_parsed = true;
+
+	const size_t size = bytes.size();
+	if(size < 14) {
+		return;
+	}
+
+	// Parse type field and VLAN tags
+	size_t offset = 14;
+	uint16_t type_field = (bytes[12] << 8) | bytes[13];
+	for(size_t i = 0; i < 2 && (type_field == 0x8100 || type_field == 0x88A8 || type_field == 0x9100) && size >= offset + 4; ++i) {
+		type_field = (bytes[offset+2] << 8) | bytes[offset+3];
+		offset += 4;
+	}
+	headers.type_field = type_field;
+	headers.network_layer_offset = offset;
+
+	// Parse network layer
+	uint32_t hash = 2166136261;
+	size_t transport_layer_offset = 0;
+	if(type_field == 0x0800 && size >= offset + 20 && (bytes[offset] >> 4) == 4) {
+		// IPv4
+		const size_t ip_header_length = (bytes[offset] & 0x0F) * 4;
+		if(ip_header_length < 20 || size < offset + ip_header_length) {
+			return;
+		}
+
+		headers.ip_version = 4;
+		headers.dscp = bytes[offset+1] >> 2;
+		headers.ecn = bytes[offset+1] & 0b00000011;
+		headers.protocol = bytes[offset+9];
+
+		const uint16_t fragment_offset = ((bytes[offset+6] << 8) | bytes[offset+7]) & 0x1FFF;
+		headers.fragment = (fragment_offset != 0) || (bytes[offset+6] & 0x20);
+		if(fragment_offset == 0) {
+			transport_layer_offset = offset + ip_header_length;
+		}
+
+		hash = hashBytes(hash, bytes.data() + offset + 12, 8);
+	} else if(type_field == 0x86DD && size >= offset + 40 && (bytes[offset] >> 4) == 6) {
+		// IPv6
+		const uint8_t traffic_class = ((bytes[offset] & 0x0F) << 4) | (bytes[offset+1] >> 4);
+		headers.ip_version = 6;
+		headers.dscp = traffic_class >> 2;
+		headers.ecn = traffic_class & 0b00000011;
+
+		// Skip extension headers
+		uint8_t next_header = bytes[offset+6];
+		size_t header_offset = offset + 40;
+		bool complete = true;
+		for(size_t i = 0; i < 8 && complete; ++i) {
+			if(next_header == 0 || next_header == 43 || next_header == 60) {
+				// Hop-by-hop options, routing and destination options
+				if(size < header_offset + 8) {
+					complete = false;
+					break;
+				}
+				next_header = bytes[header_offset];
+				header_offset += (bytes[header_offset+1] + 1) * 8;
+			} else if(next_header == 44) {
+				// Fragment
+				if(size < header_offset + 8) {
+					complete = false;
+					break;
+				}
+				headers.fragment = true;
+				if((((bytes[header_offset+2] << 8) | bytes[header_offset+3]) & 0xFFF8) != 0) {
+					complete = false;
+				}
+				next_header = bytes[header_offset];
+				header_offset += 8;
+			} else if(next_header == 51) {
+				// Authentication header
+				if(size < header_offset + 8) {
+					complete = false;
+					break;
+				}
+				next_header = bytes[header_offset];
+				header_offset += (bytes[header_offset+1] + 2) * 4;
+			} else {
+				break;
+			}
+		}
+		headers.protocol = next_header;
+		if(complete && header_offset <= size) {
+			transport_layer_offset = header_offset;
+		}
+
+		hash = hashBytes(hash, bytes.data() + offset + 8, 32);
+	} else {
+		return;
+	}
+
+	headers.transport_layer_offset = transport_layer_offset;
+
+	// Ports of TCP, UDP, SCTP and UDP-Lite
+	hash = hashBytes(hash, &headers.protocol, 1);
+	const uint8_t protocol = headers.protocol;
+	if(!headers.fragment && transport_layer_offset != 0 && size >= transport_layer_offset + 4 &&
+	   (protocol == 6 || protocol == 17 || protocol == 132 || protocol == 136)) {
+		hash = hashBytes(hash, bytes.data() + transport_layer_offset, 4);
+	}
+	headers.flow_hash = hash;
+}
+
+size_t Packet::parseEthernetHeader(uint16_t &type_field) {
+	const Headers &headers = getHeaders();
+	type_field = headers.type_field;
+
+	return headers.network_layer_offset;
+}
 
-	// Handle type field
-	if(type_field != 0x0800) {
-		// Not IPv4
+void Packet::updateIPv4HeaderChecksum() {
+	const Headers &headers = getHeaders();
+	if(headers.ip_version != 4) {
 		return;
 	}
+	const size_t network_layer_offset = headers.network_layer_offset;
 
 	uint32_t checksum = 0;
 
@@ -99,32 +278,101 @@ void Packet::updateIPv4HeaderChecksum() {
 	bytes[network_layer_offset+11] = checksum;
 }
 
+void Packet::rewriteIPv4HeaderWord(size_t offset, uint16_t value) {
+	const Headers &headers = getHeaders();
+	if(headers.ip_version != 4) {
+		return;
+	}
+
+	const size_t position = headers.network_layer_offset + offset;
+	const size_t checksum_position = headers.network_layer_offset + 10;
+	const uint16_t old_value = (bytes[position] << 8) | bytes[position+1];
+	const uint16_t checksum = updateChecksum((bytes[checksum_position] << 8) | bytes[checksum_position+1], old_value, value);
+
+	bytes[position] = value >> 8;
+	bytes[position+1] = value;
+	bytes[checksum_position] = checksum >> 8;
+	bytes[checksum_position+1] = checksum;
+}
+
+uint16_t Packet::updateChecksum(uint16_t checksum, uint16_t old_value, uint16_t new_value) {
+	// HC' = ~(~HC + ~m + m'), see equation 3 of RFC 1624
+	uint32_t sum = (uint16_t) ~checksum + (uint16_t) ~old_value + new_value;
+
+	// Add end-around carry
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+
+	return ~sum;
+}
+
 uint8_t Packet::getECN() {
-	uint16_t type_field;
-	size_t network_layer_offset = parseEthernetHeader(type_field);
+	return getHeaders().ecn;
+}
 
-	// Handle type field
-	if(type_field == 0x0800) {
-		// IPv4
-		return bytes[network_layer_offset+1] & 0b00000011;
-	} else if(type_field == 0x86DD) {
-		// IPv6
-		return ((bytes[network_layer_offset+1] & 0b00110000) >> 4);
+void Packet::setECN(uint8_t ecn) {
+	if(!headers_parsed) {
+		parseHeaders();
+	}
+	const size_t network_layer_offset = headers.network_layer_offset;
+
+	if(headers.ip_version == 4) {
+		// Type of service shares a word with version and header length
+		const uint8_t type_of_service = (bytes[network_layer_offset+1] & ~0b00000011) | (ecn & 0b00000011);
+		rewriteIPv4HeaderWord(0, (bytes[network_layer_offset] << 8) | type_of_service);
+	} else if(headers.ip_version == 6) {
+		bytes[network_layer_offset+1] = (bytes[network_layer_offset+1] & ~0b00110000) | ((ecn << 4) & 0b00110000);
+	} else {
+		return;
+	}
+
+	headers.ecn = ecn & 0b00000011;
+}
+
+uint8_t Packet::getDSCP() {
+	return getHeaders().dscp;
+}
+
+void Packet::setDSCP(uint8_t dscp) {
+	if(!headers_parsed) {
+		parseHeaders();
+	}
+	const size_t network_layer_offset = headers.network_layer_offset;
+
+	if(headers.ip_version == 4) {
+		const uint8_t type_of_service = (bytes[network_layer_offset+1] & 0b00000011) | (dscp << 2);
+		rewriteIPv4HeaderWord(0, (bytes[network_layer_offset] << 8) | type_of_service);
+	} else if(headers.ip_version == 6) {
+		// Traffic class spans the first two bytes
+		bytes[network_layer_offset] = (bytes[network_layer_offset] & 0xF0) | ((dscp >> 2) & 0x0F);
+		bytes[network_layer_offset+1] = (bytes[network_layer_offset+1] & 0b00111111) | (dscp << 6);
+	} else {
+		return;
+	}
+
+	headers.dscp = dscp & 0b00111111;
+}
+
+uint8_t Packet::getTTL() {
+	const Headers &headers = getHeaders();
+
+	if(headers.ip_version == 4) {
+		return bytes[headers.network_layer_offset+8];
+	} else if(headers.ip_version == 6) {
+		// Hop limit
+		return bytes[headers.network_layer_offset+7];
 	}
 
 	return 0;
 }
 
-void Packet::setECN(uint8_t ecn) {
-	uint16_t type_field;
-	size_t network_layer_offset = parseEthernetHeader(type_field);
+void Packet::setTTL(uint8_t ttl) {
+	const Headers &headers = getHeaders();
 
-	// Handle type field
-	if(type_field == 0x0800) {
-		// IPv4
-		bytes[network_layer_offset+1] = (bytes[network_layer_offset+1] & ~0b00000011) | (ecn & 0b00000011);
-	} else if(type_field == 0x86DD) {
-		// IPv6
-		bytes[network_layer_offset+1] = (bytes[network_layer_offset+1] & ~0b00110000) | ((ecn << 4) & 0b00110000);
+	if(headers.ip_version == 4) {
+		// Time to live shares a word with the protocol
+		rewriteIPv4HeaderWord(8, (ttl << 8) | bytes[headers.network_layer_offset+9]);
+	} else if(headers.ip_version == 6) {
+		bytes[headers.network_layer_offset+7] = ttl;
 	}
 }
@@ -22,30 +22,355 @@
 #ifndef PACKET_HPP
 #define PACKET_HPP
 
+#include <array>
+#include <atomic>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <new>
 #include <chrono>
+#include <utility>
+
+#include "PacketPool.hpp"
+
+class PacketBuffer;
+
+// Memory that packet buffers can reference instead of copying it, e.g. the
+// frames of a memory mapped ring. The owner is notified when a buffer starts
+// and stops referencing its memory.
+class PacketBufferOwner {
+	public:
+		virtual void attach(PacketBuffer &buffer) = 0;
+		virtual void release(PacketBuffer &buffer) = 0;
+
+	protected:
+		~PacketBufferOwner() = default;
+};
+
+// Packet data in a slab of the packet pool or in memory of an owner
+class PacketBuffer {
+	public:
+		PacketBuffer() = default;
+		PacketBuffer(const uint8_t *data, size_t size) {
+			assign(data, size);
+		}
+		PacketBuffer(uint8_t *data, size_t size, PacketBufferOwner &owner) {
+			reference(data, size, owner);
+		}
+		PacketBuffer(const PacketBuffer &other) : PacketBuffer(other.data(), other.size()) {
+		}
+		PacketBuffer& operator=(const PacketBuffer &other) {
+			if(this != &other) {
+				assign(other.data(), other.size());
+			}
+			return *this;
+		}
+		~PacketBuffer() {
+			free();
+		}
+
+		void assign(const uint8_t *data, size_t size) {
+			if(size > capacity || owner != nullptr) {
+				size_t new_capacity;
+				uint8_t *new_buffer = static_cast<uint8_t*>(PacketPool::allocate(size, new_capacity));
+				if(size > 0) {
+					std::memcpy(new_buffer, data, size);
+				}
+				free();
+				buffer = new_buffer;
+				capacity = new_capacity;
+			} else if(size > 0) {
+				std::memmove(buffer, data, size);
+			}
+			length = size;
+		}
+
+		void reference(uint8_t *data, size_t size, PacketBufferOwner &owner) {
+			free();
+			buffer = data;
+			length = size;
+			this->owner = &owner;
+			owner.attach(*this);
+		}
+
+		// Copies referenced memory into a slab of the packet pool, so that
+		// the owner can reuse it
+		void detach() {
+			if(owner != nullptr) {
+				assign(buffer, length);
+			}
+		}
+		bool isReferenced() const {
+			return owner != nullptr;
+		}
+
+		// Can be used by the owner to keep track of its buffers
+		size_t getOwnerIndex() const {
+			return owner_index;
+		}
+		void setOwnerIndex(size_t owner_index) {
+			this->owner_index = owner_index;
+		}
+
+		uint8_t* data() {
+			return buffer;
+		}
+		const uint8_t* data() const {
+			return buffer;
+		}
+		size_t size() const {
+			return length;
+		}
+		bool empty() const {
+			return length == 0;
+		}
+
+		uint8_t& operator[](size_t index) {
+			return buffer[index];
+		}
+		const uint8_t& operator[](size_t index) const {
+			return buffer[index];
+		}
+
+		const uint8_t* begin() const {
+			return buffer;
+		}
+		const uint8_t* end() const {
+			return buffer + length;
+		}
+
+	private:
+		uint8_t *buffer = nullptr;
+		size_t length = 0;
+		size_t capacity = 0;
+
+		PacketBufferOwner *owner = nullptr;
+		size_t owner_index = 0;
+
+		void free() {
+			if(owner != nullptr) {
+				PacketBufferOwner *previous_owner = owner;
+				owner = nullptr;
+				previous_owner->release(*this);
+			} else if(buffer != nullptr) {
+				PacketPool::release(buffer);
+			}
+			buffer = nullptr;
+			capacity = 0;
+		}
+};
+
+class PacketRef;
 
 class Packet {
 	public:
 		Packet(const std::vector<uint8_t> &bytes);
 		Packet(const uint8_t *data, size_t size);
 
+		// References the data instead of copying it
+		Packet(uint8_t *data, size_t size, PacketBufferOwner &owner);
+
+		// Allocates the packet from the packet pool
+		template<typename... Args> static PacketRef create(Args&&... args);
+
 		void setBytes(const std::vector<uint8_t> &bytes);
-		const std::vector<uint8_t>& getBytes() const;
+		void setBytes(const uint8_t *data, size_t size);
+		const PacketBuffer& getBytes() const;
 
+		// Copies referenced data into the packet pool, e.g. before the data
+		// is handed to an asynchronous operation
+		void detachBytes();
+
+		void setCreationTimePoint(const std::chrono::high_resolution_clock::time_point &creation_time_point);
 		const std::chrono::high_resolution_clock::time_point& getCreationTimePoint() const;
 
+		// Time at which the kernel received the packet, if the socket reports
+		// it, and the creation time otherwise
+		void setIngressTimePoint(const std::chrono::high_resolution_clock::time_point &ingress_time_point);
+		const std::chrono::high_resolution_clock::time_point& getIngressTimePoint() const;
+
+		// Time at which the socket should release the packet
+		void setDepartureTimePoint(const std::chrono::high_resolution_clock::time_point &departure_time_point);
+		const std::chrono::high_resolution_clock::time_point& getDepartureTimePoint() const;
+		bool hasDepartureTimePoint() const;
+
+		// Results that modules pass on downstream instead of deriving them
+		// again, kept inside the packet without any allocation
+		struct Annotations {
+			// Side of the graph at which the packet has been received
+			enum class Side : uint8_t {none, left, right};
+			Side ingress_side = Side::none;
+
+			// Times at which the packet left modules that held it, the last
+			// entry is overwritten once all are used
+			struct Hop {
+				const char *label;
+				std::chrono::high_resolution_clock::time_point time_point;
+			};
+			static constexpr size_t max_hops = 8;
+			std::array<Hop, max_hops> hops;
+			uint8_t hop_count = 0;
+		};
+		Annotations& getAnnotations();
+		const Annotations& getAnnotations() const;
+
+		// Hops are only recorded while a module reads them, e.g. a delay
+		// meter that measures from the last hop, so that modules do not take
+		// the time for every packet otherwise
+		static void addHopReader();
+		static void removeHopReader();
+		void addHop(const char *label) {
+			if(hop_readers.load(std::memory_order_relaxed) != 0) {
+				recordHop(label);
+			}
+		}
+
+		// Offload information of GSO packets and packets without checksum as
+		// a raw virtio-net header, see VirtioNet.hpp for access to its fields
+		static constexpr size_t vnet_header_size = 10;
+		typedef std::array<uint8_t, vnet_header_size> VnetHeader;
+		void setVnetHeader(const VnetHeader &vnet_header);
+		const VnetHeader& getVnetHeader() const;
+
+		// Header fields and offsets, parsed on first use and kept until the
+		// bytes are replaced
+		struct Headers {
+			// Type field after up to two VLAN tags (802.1Q, QinQ)
+			uint16_t type_field = 0;
+			size_t network_layer_offset = 14;
+
+			// IP version is 0 for other network layer protocols, the
+			// protocol is the one after the IPv6 extension headers
+			uint8_t ip_version = 0;
+			uint8_t dscp = 0;
+			uint8_t ecn = 0;
+			uint8_t protocol = 0;
+			bool fragment = false;
+
+			// Offset is 0 if the transport layer header is not available,
+			// e.g. for fragments other than the first one
+			size_t transport_layer_offset = 0;
+
+			// Hash of the addresses, protocol and ports, ports are left
+			// out for fragments so that all fragments hash alike
+			uint32_t flow_hash = 0;
+		};
+		const Headers& getHeaders() const;
+
 		size_t parseEthernetHeader(uint16_t &type_field);
 
 		void updateIPv4HeaderChecksum();
 
+		// Header rewrites patch the IPv4 header checksum incrementally
+		// (RFC 1624), IPv6 has no header checksum and the fields are not
+		// part of the pseudo header of the transport layer
+		void rewriteIPv4HeaderWord(size_t offset, uint16_t value);
+		static uint16_t updateChecksum(uint16_t checksum, uint16_t old_value, uint16_t new_value);
+
 		uint8_t getECN();
 		void setECN(uint8_t ecn);
+		uint8_t getDSCP();
+		void setDSCP(uint8_t dscp);
+		uint8_t getTTL();
+		void setTTL(uint8_t ttl);
 
 	private:
-		std::vector<uint8_t> bytes;
+		friend class PacketRef;
+
+		// Not copied along with the packet
+		struct ReferenceCount {
+			uint32_t value = 0;
+
+			ReferenceCount() = default;
+			ReferenceCount(const ReferenceCount&) {}
+			ReferenceCount& operator=(const ReferenceCount&) {
+				return *this;
+			}
+		} reference_count;
+
+		PacketBuffer bytes;
+
+		mutable Headers headers;
+		mutable bool headers_parsed = false;
+		void parseHeaders() const;
+
 		std::chrono::high_resolution_clock::time_point creation_time_point = std::chrono::high_resolution_clock::now();
+		std::chrono::high_resolution_clock::time_point ingress_time_point = creation_time_point;
+		std::chrono::high_resolution_clock::time_point departure_time_point = {};
+		VnetHeader vnet_header = {};
+		Annotations annotations;
+
+		inline static std::atomic<unsigned int> hop_readers = 0;
+		void recordHop(const char *label);
+};
+
+// Handle to a packet of the packet pool with an intrusive reference count.
+// The count is not atomic, so all handles to a packet have to be held by the
+// same thread. Packets are handed over to another thread by moving the last
+// handle or by copying the packet.
+class PacketRef {
+	public:
+		PacketRef() = default;
+		PacketRef(std::nullptr_t) {
+		}
+		explicit PacketRef(Packet *packet) : packet(packet) {
+			if(packet != nullptr) {
+				packet->reference_count.value++;
+			}
+		}
+		PacketRef(const PacketRef &other) : PacketRef(other.packet) {
+		}
+		PacketRef(PacketRef &&other) noexcept : packet(other.packet) {
+			other.packet = nullptr;
+		}
+		PacketRef& operator=(PacketRef other) noexcept {
+			std::swap(packet, other.packet);
+			return *this;
+		}
+		~PacketRef() {
+			reset();
+		}
+
+		void reset() {
+			if(packet != nullptr && --packet->reference_count.value == 0) {
+				packet->~Packet();
+				PacketPool::release(packet);
+			}
+			packet = nullptr;
+		}
+
+		Packet* get() const {
+			return packet;
+		}
+		Packet* operator->() const {
+			return packet;
+		}
+		Packet& operator*() const {
+			return *packet;
+		}
+		explicit operator bool() const {
+			return packet != nullptr;
+		}
+
+		// No other handle refers to the packet
+		bool unique() const {
+			return packet != nullptr && packet->reference_count.value == 1;
+		}
+
+		bool operator==(const PacketRef &other) const {
+			return packet == other.packet;
+		}
+		bool operator!=(const PacketRef &other) const {
+			return packet != other.packet;
+		}
+
+	private:
+		Packet *packet = nullptr;
 };
 
+template<typename... Args> PacketRef Packet::create(Args&&... args) {
+	return PacketRef(new(PacketPool::allocate(sizeof(Packet))) Packet(std::forward<Args>(args)...));
+}
+
 #endif
@@ -0,0 +1,145 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "PacketPool.hpp"
+
+#include <iostream>
+#include <new>
+
+#include <sys/mman.h>
+
+using namespace std;
+
+constexpr array<size_t, 3> PacketPool::slab_sizes;
+atomic<bool> PacketPool::hugepages = {false};
+
+// Pools are never destroyed, as slabs can still be in use by other threads
+// when the owning thread exits
+static thread_local PacketPool *local_pool = nullptr;
+
+PacketPool::PacketPool() {
+	for(uint8_t size_class = 0; size_class < slab_sizes.size(); ++size_class) {
+		allocateChunk(size_class);
+	}
+}
+
+PacketPool& PacketPool::local() {
+	if(local_pool == nullptr) {
+		local_pool = new PacketPool();
+	}
+
+	return *local_pool;
+}
+
+void PacketPool::setHugepages(bool hugepages) {
+	PacketPool::hugepages = hugepages;
+}
+
+void* PacketPool::allocate(size_t size) {
+	size_t capacity;
+	return allocate(size, capacity);
+}
+
+void* PacketPool::allocate(size_t size, size_t &capacity) {
+	uint8_t size_class = 0;
+	while(size_class < slab_sizes.size() && slab_sizes[size_class] < size) {
+		size_class++;
+	}
+
+	// Larger allocations are rare and served by the heap
+	if(size_class == slab_sizes.size()) {
+		Slab *slab = static_cast<Slab*>(::operator new(sizeof(Slab) + size, align_val_t(alignof(Slab))));
+		slab->owner = nullptr;
+		slab->size_class = heap_size_class;
+
+		capacity = size;
+		return slab + 1;
+	}
+
+	PacketPool &pool = local();
+	if(pool.free_slabs[size_class] == nullptr) {
+		pool.free_slabs[size_class] = pool.remote_free_slabs[size_class].exchange(nullptr, memory_order_acquire);
+		if(pool.free_slabs[size_class] == nullptr) {
+			pool.allocateChunk(size_class);
+		}
+	}
+
+	Slab *slab = pool.free_slabs[size_class];
+	pool.free_slabs[size_class] = slab->next;
+
+	capacity = slab_sizes[size_class];
+	return slab + 1;
+}
+
+void PacketPool::release(void *pointer) {
+	Slab *slab = static_cast<Slab*>(pointer) - 1;
+
+	if(slab->size_class == heap_size_class) {
+		::operator delete(slab, align_val_t(alignof(Slab)));
+		return;
+	}
+
+	PacketPool *owner = slab->owner;
+	if(owner == local_pool) {
+		slab->next = owner->free_slabs[slab->size_class];
+		owner->free_slabs[slab->size_class] = slab;
+		return;
+	}
+
+	// The owner takes the whole list at once, so pushing cannot suffer
+	// from the ABA problem
+	auto &remote_free_slabs = owner->remote_free_slabs[slab->size_class];
+	slab->next = remote_free_slabs.load(memory_order_relaxed);
+	while(!remote_free_slabs.compare_exchange_weak(slab->next, slab, memory_order_release, memory_order_relaxed)) {
+	}
+}
+
+void PacketPool::allocateChunk(uint8_t size_class) {
+	void *chunk = MAP_FAILED;
+	if(hugepages) {
+		chunk = mmap(nullptr, chunk_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+		if(chunk == MAP_FAILED) {
+			static atomic<bool> warned = {false};
+			if(!warned.exchange(true)) {
+				cerr << "Cannot allocate huge pages for packet buffers, use transparent huge pages instead!" << endl;
+			}
+		}
+	}
+	if(chunk == MAP_FAILED) {
+		chunk = mmap(nullptr, chunk_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(chunk == MAP_FAILED) {
+			throw bad_alloc();
+		}
+		if(hugepages) {
+			madvise(chunk, chunk_size, MADV_HUGEPAGE);
+		}
+	}
+
+	// Split chunk into slabs
+	const size_t slab_size = sizeof(Slab) + slab_sizes[size_class];
+	for(size_t offset = 0; offset + slab_size <= chunk_size; offset += slab_size) {
+		Slab *slab = reinterpret_cast<Slab*>(static_cast<uint8_t*>(chunk) + offset);
+		slab->owner = this;
+		slab->size_class = size_class;
+		slab->next = free_slabs[size_class];
+		free_slabs[size_class] = slab;
+	}
+}
@@ -0,0 +1,70 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACKET_POOL_HPP
+#define PACKET_POOL_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Allocator for packets and their data that hands out fixed-size slabs from
+// preallocated chunks instead of using the heap. Every thread allocates from
+// its own pool without locks or atomic operations. Slabs released by another
+// thread are pushed to a lock-free list of the owning pool and reused from
+// there once its local slabs are used up.
+class PacketPool {
+	public:
+		// Slab for at least the given number of bytes, the actually usable
+		// size is returned through capacity
+		static void* allocate(size_t size);
+		static void* allocate(size_t size, size_t &capacity);
+		static void release(void *pointer);
+
+		// Chunks allocated afterwards are backed by huge pages if possible
+		static void setHugepages(bool hugepages);
+
+	private:
+		// Every slab starts with a header on its own cache line, so that
+		// the data of neighboring slabs does not share cache lines
+		struct alignas(64) Slab {
+			Slab *next;
+			PacketPool *owner;
+			uint8_t size_class;
+		};
+
+		static constexpr std::array<size_t, 3> slab_sizes = {512, 2048, 65536 + 2048};
+		static constexpr uint8_t heap_size_class = 0xFF;
+		static constexpr size_t chunk_size = 2 * 1024 * 1024;
+
+		static std::atomic<bool> hugepages;
+		static PacketPool& local();
+
+		PacketPool();
+
+		std::array<Slab*, slab_sizes.size()> free_slabs = {};
+		std::array<std::atomic<Slab*>, slab_sizes.size()> remote_free_slabs = {};
+
+		void allocateChunk(uint8_t size_class);
+};
+
+#endif
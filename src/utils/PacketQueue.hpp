@@ -0,0 +1,118 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACKET_QUEUE_HPP
+#define PACKET_QUEUE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// FIFO queue on a contiguous ring buffer for packet handles and entries that
+// keep a timestamp next to the handle. In contrast to std::queue, entries are
+// stored inline without per-block allocations and the buffer is kept when the
+// queue drains, so it only allocates while growing to its largest size.
+template<typename T> class PacketQueue {
+	public:
+		PacketQueue() {
+			grow();
+		}
+		PacketQueue(const PacketQueue&) = delete;
+		PacketQueue& operator=(const PacketQueue&) = delete;
+
+		bool empty() const {
+			return count == 0;
+		}
+		size_t size() const {
+			return count;
+		}
+
+		// Front of an empty queue is a default-constructed entry
+		T& front() {
+			return entries[head];
+		}
+		const T& front() const {
+			return entries[head];
+		}
+		T& back() {
+			return entries[(head + count - 1) & mask];
+		}
+		const T& back() const {
+			return entries[(head + count - 1) & mask];
+		}
+
+		void push(const T &entry) {
+			emplace(entry);
+		}
+		void push(T &&entry) {
+			emplace(std::move(entry));
+		}
+		template<typename... Args> T& emplace(Args&&... args) {
+			if(count == capacity) {
+				grow();
+			}
+
+			T &entry = entries[(head + count) & mask];
+			entry = T(std::forward<Args>(args)...);
+			count++;
+
+			return entry;
+		}
+
+		// Resets the entry so that a packet is released right away and not
+		// only once its slot is reused
+		void pop() {
+			entries[head] = T();
+			head = (head + 1) & mask;
+			count--;
+		}
+
+		// Preallocates space for the given number of entries
+		void reserve(size_t size) {
+			while(capacity < size) {
+				grow();
+			}
+		}
+
+	private:
+		std::unique_ptr<T[]> entries;
+		size_t capacity = 0;
+		size_t mask = 0;
+		size_t head = 0;
+		size_t count = 0;
+
+		// Capacity is kept at a power of two, so that indices wrap around
+		// with a mask
+		void grow() {
+			const size_t new_capacity = (capacity == 0) ? 64 : capacity * 2;
+			std::unique_ptr<T[]> new_entries(new T[new_capacity]);
+			for(size_t i = 0; i < count; i++) {
+				new_entries[i] = std::move(entries[(head + i) & mask]);
+			}
+
+			entries = std::move(new_entries);
+			capacity = new_capacity;
+			mask = new_capacity - 1;
+			head = 0;
+		}
+};
+
+#endif
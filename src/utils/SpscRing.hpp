@@ -0,0 +1,104 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free ring for handing entries from exactly one producer thread
+// to exactly one consumer thread. Both indices live on their own cache line
+// and each side keeps a copy of the other side's index, so that the shared
+// cache lines are only touched when the cached view runs out.
+template<typename T> class SpscRing {
+	public:
+		// Capacity is rounded up to a power of two
+		explicit SpscRing(size_t capacity) {
+			size_t size = 1;
+			while(size < capacity) {
+				size *= 2;
+			}
+
+			entries.reset(new T[size]);
+			mask = size - 1;
+		}
+		SpscRing(const SpscRing&) = delete;
+		SpscRing& operator=(const SpscRing&) = delete;
+
+		// Producer side, returns false if the ring is full
+		bool push(T &&entry) {
+			const size_t tail = producer.index.load(std::memory_order_relaxed);
+			if(tail - producer.cached_index > mask) {
+				producer.cached_index = consumer.index.load(std::memory_order_acquire);
+				if(tail - producer.cached_index > mask) {
+					return false;
+				}
+			}
+
+			entries[tail & mask] = std::move(entry);
+			producer.index.store(tail + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		// Consumer side, moves up to the given number of entries to the
+		// output iterator and returns their number
+		template<typename OutputIterator> size_t pop(OutputIterator output, size_t max_count) {
+			const size_t head = consumer.index.load(std::memory_order_relaxed);
+			if(consumer.cached_index == head) {
+				consumer.cached_index = producer.index.load(std::memory_order_acquire);
+			}
+
+			size_t count = 0;
+			while(count < max_count && head + count != consumer.cached_index) {
+				*output++ = std::move(entries[(head + count) & mask]);
+				entries[(head + count) & mask] = T();
+				count++;
+			}
+
+			if(count != 0) {
+				consumer.index.store(head + count, std::memory_order_release);
+			}
+
+			return count;
+		}
+
+		// Approximation if called while the other side is active
+		bool empty() const {
+			return consumer.index.load(std::memory_order_acquire) == producer.index.load(std::memory_order_acquire);
+		}
+
+	private:
+		struct alignas(64) Side {
+			std::atomic<size_t> index{0};
+			size_t cached_index = 0;
+		};
+		Side producer;
+		Side consumer;
+
+		std::unique_ptr<T[]> entries;
+		size_t mask;
+};
+
+#endif
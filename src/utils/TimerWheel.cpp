@@ -0,0 +1,285 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TimerWheel.hpp"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+using namespace std;
+
+boost::asio::io_service::id TimerWheel::id;
+
+TimerWheel::TimerWheel(boost::asio::io_service &io_service) : boost::asio::io_service::service(io_service), time(toTicks(chrono::high_resolution_clock::now())), timer(io_service) {
+}
+
+uint64_t TimerWheel::toTicks(chrono::high_resolution_clock::time_point time_point) {
+	const int64_t ticks = chrono::duration_cast<chrono::nanoseconds>(time_point.time_since_epoch()).count();
+
+	return max<int64_t>(ticks, 0);
+}
+
+void TimerWheel::schedule(Entry &entry, uint64_t deadline, Handler &&handler) {
+	unique_lock<mutex> lock(wheel_mutex);
+
+	if(entry.list != nullptr) {
+		unlink(entry);
+	}
+
+	entry.deadline = deadline;
+	entry.handler = move(handler);
+	insert(entry);
+
+	// Only a deadline before the armed one moves the timer of the I/O
+	// service, so no slot has to be searched. Handlers that are dispatched
+	// right now might add further timers, the timer is armed once they are
+	// done.
+	if(!dispatching && deadline < armed) {
+		arm(deadline);
+	}
+}
+
+bool TimerWheel::cancel(Entry &entry) {
+	unique_lock<mutex> lock(wheel_mutex);
+
+	if(entry.list == nullptr) {
+		return false;
+	}
+
+	// The timer of the I/O service is left as it is, waking up once too
+	// often is cheaper than rearming it for every cancellation
+	unlink(entry);
+	entry.handler = nullptr;
+
+	return true;
+}
+
+void TimerWheel::link(Entry &entry, Entry **list) {
+	entry.list = list;
+	entry.prev = nullptr;
+	entry.next = *list;
+	if(entry.next != nullptr) {
+		entry.next->prev = &entry;
+	}
+	*list = &entry;
+}
+
+void TimerWheel::unlink(Entry &entry) {
+	if(entry.prev != nullptr) {
+		entry.prev->next = entry.next;
+	} else {
+		*entry.list = entry.next;
+	}
+	if(entry.next != nullptr) {
+		entry.next->prev = entry.prev;
+	}
+
+	// Slots that run empty are no longer considered
+	if(*entry.list == nullptr && entry.list != &expired) {
+		const size_t index = entry.list - &slots[0][0];
+		occupied[index / slots_per_level][(index % slots_per_level) / 64] &= ~(1ULL << (index % 64));
+	}
+
+	entry.list = nullptr;
+	entry.prev = nullptr;
+	entry.next = nullptr;
+}
+
+void TimerWheel::insert(Entry &entry) {
+	if(entry.deadline <= time) {
+		link(entry, &expired);
+		return;
+	}
+
+	const size_t level = (63 - __builtin_clzll(entry.deadline ^ time)) / 8;
+	const size_t slot = (entry.deadline >> (level * 8)) & (slots_per_level - 1);
+	link(entry, &slots[level][slot]);
+	occupied[level][slot / 64] |= 1ULL << (slot % 64);
+}
+
+void TimerWheel::advance(uint64_t now) {
+	if(now <= time) {
+		return;
+	}
+
+	// Slots that have been passed on any level are emptied. Their entries
+	// are either expired or move down to a lower level relative to the new
+	// time.
+	Entry *pending = nullptr;
+	for(size_t level = 0; level < levels; ++level) {
+		const size_t shift = level * 8;
+		const uint64_t elapsed = (now >> shift) - (time >> shift);
+		if(elapsed == 0) {
+			break;
+		}
+
+		const size_t current = (time >> shift) & (slots_per_level - 1);
+		const size_t last = min<uint64_t>(slots_per_level - 1, current + elapsed);
+		for(size_t slot = current + 1; slot <= last; ++slot) {
+			// Skip empty words at once
+			if(occupied[level][slot / 64] >> (slot % 64) == 0) {
+				slot |= 63;
+				continue;
+			}
+
+			Entry *entry = slots[level][slot];
+			while(entry != nullptr) {
+				Entry *next = entry->next;
+				entry->list = nullptr;
+				entry->prev = nullptr;
+				entry->next = pending;
+				pending = entry;
+				entry = next;
+			}
+			slots[level][slot] = nullptr;
+			occupied[level][slot / 64] &= ~(1ULL << (slot % 64));
+		}
+	}
+
+	time = now;
+
+	while(pending != nullptr) {
+		Entry *next = pending->next;
+		insert(*pending);
+		pending = next;
+	}
+}
+
+uint64_t TimerWheel::getEarliestDeadline() const {
+	if(expired != nullptr) {
+		return time;
+	}
+
+	// Lower levels always expire before higher ones. Below level 0 only the
+	// start of the slot is known, the entries move down once it is reached.
+	for(size_t level = 0; level < levels; ++level) {
+		const size_t shift = level * 8;
+		const size_t current = (time >> shift) & (slots_per_level - 1);
+		for(size_t word = (current + 1) / 64; word < occupied[level].size(); ++word) {
+			uint64_t bits = occupied[level][word];
+			if(word == (current + 1) / 64) {
+				bits &= ~0ULL << ((current + 1) % 64);
+			}
+			if(bits == 0) {
+				continue;
+			}
+
+			const uint64_t slot = word * 64 + __builtin_ctzll(bits);
+			const uint64_t prefix = (shift + 8 < 64) ? (time >> (shift + 8)) << (shift + 8) : 0;
+			return prefix | (slot << shift);
+		}
+	}
+
+	return never;
+}
+
+void TimerWheel::rearm() {
+	const uint64_t deadline = getEarliestDeadline();
+	if(deadline == never || deadline >= armed) {
+		return;
+	}
+
+	arm(deadline);
+}
+
+void TimerWheel::arm(uint64_t deadline) {
+	armed = deadline;
+	timer.expires_at(chrono::high_resolution_clock::time_point(chrono::duration_cast<chrono::high_resolution_clock::duration>(chrono::nanoseconds(deadline))));
+	timer.async_wait(boost::bind(&TimerWheel::handleTimer, this, boost::asio::placeholders::error));
+}
+
+void TimerWheel::handleTimer(const boost::system::error_code& error) {
+	if(error == boost::asio::error::operation_aborted) {
+		return;
+	}
+
+	unique_lock<mutex> lock(wheel_mutex);
+
+	armed = never;
+	advance(toTicks(chrono::high_resolution_clock::now()));
+
+	// Handlers are taken out of their entries, so that they can rearm
+	// their timer or cancel others while they are called
+	dispatching = true;
+	while(expired != nullptr) {
+		Entry &entry = *expired;
+		unlink(entry);
+		dispatch_handlers.push_back(move(entry.handler));
+		entry.handler = nullptr;
+	}
+	lock.unlock();
+
+	for(auto &handler : dispatch_handlers) {
+		handler(boost::system::error_code());
+	}
+	dispatch_handlers.clear();
+
+	lock.lock();
+	dispatching = false;
+	rearm();
+}
+
+void TimerWheel::shutdown() {
+	unique_lock<mutex> lock(wheel_mutex);
+
+	// Pending handlers are destroyed like those of other asio objects
+	auto clear = [&](Entry *&list) {
+		while(list != nullptr) {
+			Entry &entry = *list;
+			unlink(entry);
+			entry.handler = nullptr;
+		}
+	};
+	clear(expired);
+	for(auto &level : slots) {
+		for(auto &slot : level) {
+			clear(slot);
+		}
+	}
+
+	timer.cancel();
+}
+
+WheelTimer::WheelTimer(boost::asio::io_service &io_service) : io_service(io_service), wheel(boost::asio::use_service<TimerWheel>(io_service)) {
+}
+
+size_t WheelTimer::expires_at(const time_point &expiry_time) {
+	this->expiry_time = expiry_time;
+
+	return cancel();
+}
+
+size_t WheelTimer::expires_from_now(const duration &expiry_time) {
+	return expires_at(clock_type::now() + expiry_time);
+}
+
+size_t WheelTimer::expires_after(const duration &expiry_time) {
+	return expires_at(clock_type::now() + expiry_time);
+}
+
+size_t WheelTimer::cancel() {
+	return wheel.cancel(entry) ? 1 : 0;
+}
+
+WheelTimer::~WheelTimer() {
+	cancel();
+}
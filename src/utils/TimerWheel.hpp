@@ -0,0 +1,146 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Reference: Varghese, George and Tony Lauck (1987) Hashed and Hierarchical Timing Wheels. SOSP '87.
+
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+// Hierarchical timing wheel with nanosecond resolution that is attached to
+// an I/O service. Every level covers 8 more bits of the deadline with 256
+// slots, so adding and canceling a timer take constant time. The whole
+// wheel is driven by a single timer of the I/O service that is armed for
+// the earliest slot. Handlers run on the thread of the I/O service.
+class TimerWheel : public boost::asio::io_service::service {
+	public:
+		static boost::asio::io_service::id id;
+
+		typedef std::function<void(const boost::system::error_code&)> Handler;
+
+		// Owned by the timer, linked into the slot of its deadline while a
+		// wait is pending
+		struct Entry {
+			Entry *prev = nullptr;
+			Entry *next = nullptr;
+			Entry **list = nullptr;
+			uint64_t deadline = 0;
+			Handler handler;
+		};
+
+		TimerWheel(boost::asio::io_service &io_service);
+
+		// Deadlines are given in nanoseconds since the epoch of the high
+		// resolution clock
+		void schedule(Entry &entry, uint64_t deadline, Handler &&handler);
+
+		// Canceled handlers are destroyed without being called, returns
+		// whether a wait has been pending
+		bool cancel(Entry &entry);
+
+		static uint64_t toTicks(std::chrono::high_resolution_clock::time_point time_point);
+
+	private:
+		static constexpr size_t levels = 8;
+		static constexpr size_t slots_per_level = 256;
+		static constexpr uint64_t never = std::numeric_limits<uint64_t>::max();
+
+		// Timers and the timer of the I/O service might be touched from
+		// other threads, e.g. by parameter changes
+		std::mutex wheel_mutex;
+
+		// Entries of level n differ from the current time first in byte n of
+		// their deadline and are kept in the slot given by that byte
+		uint64_t time;
+		std::array<std::array<Entry*, slots_per_level>, levels> slots = {};
+		std::array<std::array<uint64_t, slots_per_level / 64>, levels> occupied = {};
+		Entry *expired = nullptr;
+
+		void link(Entry &entry, Entry **list);
+		void unlink(Entry &entry);
+		void insert(Entry &entry);
+		void advance(uint64_t now);
+		uint64_t getEarliestDeadline() const;
+
+		boost::asio::high_resolution_timer timer;
+		uint64_t armed = never;
+		bool dispatching = false;
+		std::vector<Handler> dispatch_handlers;
+		void rearm();
+		void arm(uint64_t deadline);
+		void handleTimer(const boost::system::error_code& error);
+
+		void shutdown() override;
+};
+
+// Drop-in replacement for boost::asio::high_resolution_timer that keeps its
+// deadline in the timing wheel of the I/O service. Only one wait can be
+// pending at a time.
+class WheelTimer {
+	public:
+		typedef std::chrono::high_resolution_clock clock_type;
+		typedef clock_type::duration duration;
+		typedef clock_type::time_point time_point;
+
+		WheelTimer(boost::asio::io_service &io_service);
+		WheelTimer(const WheelTimer&) = delete;
+		WheelTimer& operator=(const WheelTimer&) = delete;
+		~WheelTimer();
+
+		boost::asio::io_service::executor_type get_executor() {
+			return io_service.get_executor();
+		}
+
+		size_t expires_at(const time_point &expiry_time);
+		size_t expires_from_now(const duration &expiry_time);
+		size_t expires_after(const duration &expiry_time);
+
+		time_point expiry() const {
+			return expiry_time;
+		}
+
+		time_point expires_at() const {
+			return expiry_time;
+		}
+
+		template<typename WaitHandler> void async_wait(WaitHandler &&handler) {
+			wheel.schedule(entry, TimerWheel::toTicks(expiry_time), TimerWheel::Handler(std::forward<WaitHandler>(handler)));
+		}
+
+		size_t cancel();
+
+	private:
+		boost::asio::io_service &io_service;
+		TimerWheel &wheel;
+		TimerWheel::Entry entry;
+		time_point expiry_time;
+};
+
+#endif
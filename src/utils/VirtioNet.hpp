@@ -0,0 +1,52 @@
+/*
+ * FlowEmu - Flow-Based Network Emulator
+ * Copyright (c) 2021 Institute of Communication Networks (ComNets),
+ *                    Hamburg University of Technology (TUHH),
+ *                    https://www.tuhh.de/comnets
+ * Copyright (c) 2021 Daniel Stolpmann <daniel.stolpmann@tuhh.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIRTIO_NET_HPP
+#define VIRTIO_NET_HPP
+
+#include <cstring>
+
+// The header uses the C++ keyword class as a member name
+#define class class_
+#include <linux/virtio_net.h>
+#undef class
+
+#include "Packet.hpp"
+
+// Packets keep the header as plain bytes, so that only the modules that
+// interpret it include the kernel header
+static_assert(sizeof(virtio_net_hdr) == Packet::vnet_header_size, "Packet has to hold a complete virtio-net header!");
+
+inline virtio_net_hdr getVirtioNetHeader(const Packet &packet) {
+	virtio_net_hdr vnet_header;
+	memcpy(&vnet_header, packet.getVnetHeader().data(), sizeof(vnet_header));
+
+	return vnet_header;
+}
+
+inline void setVirtioNetHeader(Packet &packet, const virtio_net_hdr &vnet_header) {
+	Packet::VnetHeader bytes;
+	memcpy(bytes.data(), &vnet_header, sizeof(vnet_header));
+
+	packet.setVnetHeader(bytes);
+}
+
+#endif